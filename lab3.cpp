@@ -1,14 +1,100 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <exception>
 #include <random>
 #include <sstream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+// GCC flags free() in the replaced operator delete once it is inlined next to a new-expression
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Global allocation counters, updated by the replaced operator new below.
+// The benchmark harness reads them to report allocations per operation.
+std::atomic<unsigned long long> allocationCount{ 0 };
+std::atomic<unsigned long long> allocatedBytes{ 0 };
+
+// Opt-in attribution of allocations to Bank operations (see OperationScope). Each thread notes which
+// operation it is executing; when tracking is enabled, operator new charges the allocation to it.
+constexpr int kAllocationScopes = 16;
+std::atomic<bool> allocationTrackingEnabled{ false };
+thread_local int currentAllocationScope = -1; // -1 outside Bank operations
+std::array<std::atomic<unsigned long long>, kAllocationScopes> scopeOperations{};
+std::array<std::atomic<unsigned long long>, kAllocationScopes> scopeAllocationCount{};
+std::array<std::atomic<unsigned long long>, kAllocationScopes> scopeAllocatedBytes{};
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (currentAllocationScope >= 0 && allocationTrackingEnabled.load(std::memory_order_relaxed)) {
+        scopeAllocationCount[currentAllocationScope].fetch_add(1, std::memory_order_relaxed);
+        scopeAllocatedBytes[currentAllocationScope].fetch_add(size, std::memory_order_relaxed);
+    }
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+// Most an account of a strategy may deposit in one UTC day and in one calendar month (infinity: no limit).
+// Deposits are only counted while a limit is set, so a limit applies from the moment it is configured:
+// deposits made earlier the same day or month do not count toward it.
+struct DepositLimits {
+    double daily = std::numeric_limits<double>::infinity();
+    double monthly = std::numeric_limits<double>::infinity();
+
+    bool any() const {
+        return daily != std::numeric_limits<double>::infinity() || monthly != std::numeric_limits<double>::infinity();
+    }
+};
 
 // Interface for the deposit strategy (Polymorphism used here)
 class IDeposit {
 public:
     virtual double calculateDeposit(double amount) const = 0; // Pure virtual function
+    virtual std::string label() const = 0; // Strategy name used to group reports
+    virtual DepositLimits depositLimits() const { return {}; } // Cumulative limits per account; none by default
     virtual ~IDeposit() {} // Virtual destructor for proper cleanup
 };
 
@@ -31,14 +117,143 @@ public:
     }
 };
 
+// Exception class for handling withdrawals and transfers larger than the balance
+class InsufficientFundsException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Insufficient funds in the account";
+    }
+};
+
+// Slot of the calling thread in the reader counters of every RcuCell
+inline size_t rcuReaderSlot() {
+    static std::atomic<size_t> next{ 0 };
+    thread_local size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+// Value that readers use without locking while a writer replaces it (read-copy-update). A reader
+// counts itself in one of two counters, chosen by the epoch, before loading the pointer. A writer
+// swaps the new value in and flips the epoch twice, each time waiting for the counters of the
+// previous epoch to drain: a reader that could have loaded the old pointer counted itself before
+// the swap, so once both have drained nobody holds it and it is deleted. The counters are striped
+// over cache lines by thread, so readers on different cores do not write the same line.
+template <typename T>
+class RcuCell {
+public:
+    // Keeps the value read alive while in scope
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const RcuCell& cell) : counter(cell.enter()), value(cell.current.load()) {}
+        ~ReadGuard() {
+            counter->fetch_sub(1, std::memory_order_release);
+        }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const T* operator->() const {
+            return value;
+        }
+
+        const T& operator*() const {
+            return *value;
+        }
+
+    private:
+        std::atomic<long>* counter;
+        const T* value;
+    };
+
+    explicit RcuCell(std::unique_ptr<T> initial) : current(initial.release()) {}
+
+    ~RcuCell() {
+        delete current.load();
+    }
+
+    ReadGuard read() const {
+        return ReadGuard(*this);
+    }
+
+    // Function to replace the value. Returns after the grace period, once the previous value is deleted;
+    // concurrent writers take turns.
+    void publish(std::unique_ptr<T> next) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        T* previous = current.exchange(next.release());
+        for (int flip = 0; flip < 2; ++flip) {
+            unsigned drained = epoch.fetch_add(1) & 1;
+            for (const auto& slot : slots) {
+                while (slot.active[drained].load() != 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        delete previous;
+    }
+
+private:
+    static constexpr size_t kSlots = 16;
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<long> active[2] = { 0, 0 };
+    };
+
+    std::atomic<T*> current;
+    std::atomic<unsigned> epoch{ 0 };
+    mutable std::array<ReaderSlot, kSlots> slots;
+    std::mutex writerMutex;
+
+    std::atomic<long>* enter() const {
+        std::atomic<long>* counter = &slots[rcuReaderSlot() % kSlots].active[epoch.load() & 1];
+        counter->fetch_add(1);
+        return counter;
+    }
+};
+
+// Function to format a whole amount with thousands separators (1,000,000); other amounts print with cents
+std::string formatGroupedAmount(double amount) {
+    std::ostringstream ss;
+    if (amount != std::floor(amount) || std::fabs(amount) >= 1e15) {
+        ss << std::fixed << std::setprecision(2) << amount;
+        return ss.str();
+    }
+    std::string digits = std::to_string(static_cast<long long>(std::fabs(amount)));
+    for (size_t i = digits.size(); i > 3; i -= 3) {
+        digits.insert(i - 3, ",");
+    }
+    return (amount < 0 ? "-" : "") + digits;
+}
+
+// Parameters of FixedDeposit that can be changed while the program runs
+struct FixedDepositTerms {
+    double cap = 1000000; // Largest single deposit accepted
+    double bonus = 100;   // Added to every deposit
+    DepositLimits limits; // Cumulative deposits per account, unlimited by default
+};
+
 // Concrete strategy class for FixedDeposit
 class FixedDeposit : public IDeposit {
 public:
     double calculateDeposit(double amount) const override {
-        if (amount > 1000000) {
-            throw InvalidInputException("The maximum deposit amount for the fixed account is 1,000,000. Please deposit less.");
+        auto current = terms().read();
+        if (amount > current->cap) {
+            throw InvalidInputException("The maximum deposit amount for the fixed account is " + formatGroupedAmount(current->cap)
+                + ". Please deposit less.");
         }
-        return amount + 100; // Fixed deposit adds 100 to the deposit
+        return amount + current->bonus; // Fixed deposit adds 100 (by default) to the deposit
+    }
+
+    DepositLimits depositLimits() const override {
+        return terms().read()->limits;
+    }
+
+    // Terms shared by every FixedDeposit; publish new ones to reconfigure without a restart
+    static RcuCell<FixedDepositTerms>& terms() {
+        static RcuCell<FixedDepositTerms> cell(std::make_unique<FixedDepositTerms>());
+        return cell;
+    }
+
+    std::string label() const override {
+        return "Fixed";
     }
 };
 
@@ -48,125 +263,5933 @@ public:
     double calculateDeposit(double amount) const override {
         return amount; // No additional amount is added in NormalDeposit
     }
+
+    std::string label() const override {
+        return "Normal";
+    }
+};
+
+// Bonus brackets: sorted thresholds, each with the bonus paid from that threshold up to the next one.
+// The thresholds are padded with infinity to a power of two, so the bracket is found by a binary
+// search whose every step either adds the half width or nothing. That compiles to conditional moves
+// rather than branches, so unpredictable amounts cost no mispredictions.
+class BracketTable {
+public:
+    static constexpr size_t kCapacity = 64; // At most kCapacity - 1 brackets
+
+    BracketTable() {
+        thresholds.fill(std::numeric_limits<double>::infinity());
+        bonuses.fill(0);
+    }
+
+    // Takes (threshold, bonus) pairs in any order; amounts below the lowest threshold get no bonus
+    explicit BracketTable(std::vector<std::pair<double, double>> brackets) : BracketTable() {
+        if (brackets.size() >= kCapacity) {
+            throw InvalidInputException("At most 63 bonus tiers are supported");
+        }
+        std::sort(brackets.begin(), brackets.end());
+        for (size_t i = 0; i < brackets.size(); ++i) {
+            if (i > 0 && brackets[i].first == brackets[i - 1].first) {
+                throw InvalidInputException("Two bonus tiers have the same threshold");
+            }
+            thresholds[i] = brackets[i].first;
+            bonuses[i + 1] = brackets[i].second;
+        }
+        count = brackets.size();
+        while (width <= count) {
+            width *= 2;
+        }
+    }
+
+    // Number of thresholds at or below the amount
+    size_t bracketOf(double amount) const {
+        size_t base = 0;
+        for (size_t half = width / 2; half > 0; half /= 2) {
+            base += thresholds[base + half - 1] <= amount ? half : 0;
+        }
+        return base;
+    }
+
+    double bonus(double amount) const {
+        return bonuses[bracketOf(amount)];
+    }
+
+    // The same lookup as a chain of ifs from the highest threshold down, kept to benchmark against
+    double bonusByIfChain(double amount) const {
+        for (size_t i = count; i > 0; --i) {
+            if (amount >= thresholds[i - 1]) {
+                return bonuses[i];
+            }
+        }
+        return 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+private:
+    std::array<double, kCapacity> thresholds; // Ascending, padded with infinity
+    std::array<double, kCapacity> bonuses;    // bonuses[k]: bonus when the amount reaches k thresholds
+    size_t count = 0;
+    size_t width = 1; // Power of two above count; the search covers thresholds[0, width - 1)
+};
+
+// Concrete strategy class for TieredDeposit: like FixedDeposit, but the bonus grows with the deposit
+// through brackets from 100 up to 500,000
+class TieredDeposit : public IDeposit {
+public:
+    TieredDeposit() : brackets({ { 100, 1 }, { 250, 3 }, { 500, 7 }, { 1000, 15 }, { 2500, 40 }, { 5000, 90 },
+        { 10000, 200 }, { 25000, 500 }, { 50000, 1100 }, { 100000, 2500 }, { 250000, 6000 }, { 500000, 13000 } }) {}
+
+    double calculateDeposit(double amount) const override {
+        if (amount > 1000000) {
+            throw InvalidInputException("The maximum deposit amount for the tiered account is 1,000,000. Please deposit less.");
+        }
+        return amount + brackets.bonus(amount);
+    }
+
+    // Function to apply the strategy to a batch of deposits. Amounts above the cap are credited as -1;
+    // returns how many there were.
+    size_t calculateDeposits(const double* amounts, double* credited, size_t count) const {
+        size_t rejected = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bool over = amounts[i] > 1000000;
+            rejected += over;
+            credited[i] = over ? -1.0 : amounts[i] + brackets.bonus(amounts[i]);
+        }
+        return rejected;
+    }
+
+    const BracketTable& bonusBrackets() const {
+        return brackets;
+    }
+
+    std::string label() const override {
+        return "Tiered";
+    }
+
+private:
+    BracketTable brackets;
 };
 
-// Function to validate deposit amount (numeric and non-negative)
+// Function to validate deposit amount (finite and non-negative)
 void validateDepositAmount(double amount) {
+    if (!std::isfinite(amount)) {
+        throw InvalidInputException("Deposit amount must be a finite number");
+    }
     if (amount < 0) {
         throw NegativeDepositException();
     }
-}
+}
+
+// Function to validate a withdrawal or transfer amount (finite and non-negative); a NaN balance would
+// have no place in the balance index's order
+void validateWithdrawalAmount(double amount) {
+    if (!std::isfinite(amount)) {
+        throw InvalidInputException("Withdrawal amount must be a finite number");
+    }
+    if (amount < 0) {
+        throw InvalidInputException("Withdrawal amount cannot be negative");
+    }
+}
+
+// Function to check if a string contains only alphabetic characters
+bool isValidName(const std::string& name) {
+    for (char c : name) {
+        if (!std::isalpha(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to validate an account tag (letters, digits, '-' and '_')
+bool isValidTag(const std::string& tag) {
+    if (tag.empty()) {
+        return false;
+    }
+    for (char c : tag) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to check if the input is numeric (a finite number, so "nan" and "inf" are not)
+bool isNumeric(const std::string& str) {
+    char* end = nullptr;
+    double value = std::strtod(str.c_str(), &end);
+    return end != str.c_str() && *end == '\0' && std::isfinite(value); // Ensure the whole string is a number
+}
+
+// Deposit strategy defined in a strategies file instead of code, one per line:
+//   <Name> [cap=<amount>] [bonus=<amount>] [percent=<percent>] [tier=<threshold>:<bonus>]...
+//          [daily=<amount>] [monthly=<amount>]
+// A deposit above the cap is rejected; otherwise it is credited with the percentage and flat bonus
+// plus the bonus of the highest tier whose threshold it reaches. The rules are compiled into a flat
+// table when the file is loaded, so evaluating one is a multiply and a branchless bracket lookup,
+// and calculateDeposits runs the same table over a whole batch.
+class RuleDeposit : public IDeposit {
+public:
+    explicit RuleDeposit(const std::string& definition) : terms(nullptr) {
+        std::istringstream ss(definition);
+        if (!(ss >> name) || !isValidName(name)) {
+            throw InvalidInputException("Strategy name must contain only letters");
+        }
+        std::string rules;
+        std::getline(ss, rules);
+        terms.publish(compile(rules));
+    }
+
+    // Function to replace all rules of the strategy with new ones; deposits in flight finish with the old rules
+    void reconfigure(const std::string& rules) {
+        terms.publish(compile(rules));
+    }
+
+    double calculateDeposit(double amount) const override {
+        auto current = terms.read();
+        if (amount > current->cap) {
+            throw InvalidInputException("The maximum deposit amount for the " + name + " account is "
+                + formatGroupedAmount(current->cap) + ". Please deposit less.");
+        }
+        return evaluate(*current, amount);
+    }
+
+    DepositLimits depositLimits() const override {
+        return terms.read()->limits;
+    }
+
+    // Function to apply the strategy to a batch of deposits. Amounts above the cap are credited as -1;
+    // returns how many there were.
+    size_t calculateDeposits(const double* amounts, double* credited, size_t count) const {
+        auto current = terms.read();
+        size_t rejected = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bool over = amounts[i] > current->cap;
+            rejected += over;
+            credited[i] = over ? -1.0 : evaluate(*current, amounts[i]);
+        }
+        return rejected;
+    }
+
+    std::string label() const override {
+        return name;
+    }
+
+private:
+    struct Terms {
+        double cap = std::numeric_limits<double>::infinity();
+        double multiplier = 1;
+        double flat = 0;
+        BracketTable tierBonuses;
+        DepositLimits limits;
+    };
+
+    std::string name;
+    RcuCell<Terms> terms;
+
+    std::unique_ptr<Terms> compile(const std::string& rules) const {
+        auto compiled = std::make_unique<Terms>();
+        std::istringstream ss(rules);
+        std::vector<std::pair<double, double>> tiers;
+        for (std::string rule; ss >> rule;) {
+            size_t equals = rule.find('=');
+            std::string key = rule.substr(0, equals);
+            std::string value = equals == std::string::npos ? "" : rule.substr(equals + 1);
+            size_t colon = value.find(':');
+            if (key == "tier" && colon != std::string::npos && isNumeric(value.substr(0, colon))
+                && isNumeric(value.substr(colon + 1))) {
+                tiers.push_back({ std::stod(value.substr(0, colon)), std::stod(value.substr(colon + 1)) });
+            }
+            else if (key == "cap" && isNumeric(value) && std::stod(value) >= 0) {
+                compiled->cap = std::stod(value);
+            }
+            else if (key == "bonus" && isNumeric(value)) {
+                compiled->flat = std::stod(value);
+            }
+            else if (key == "percent" && isNumeric(value)) {
+                compiled->multiplier = 1 + std::stod(value) / 100;
+            }
+            else if (key == "daily" && isNumeric(value) && std::stod(value) >= 0) {
+                compiled->limits.daily = std::stod(value);
+            }
+            else if (key == "monthly" && isNumeric(value) && std::stod(value) >= 0) {
+                compiled->limits.monthly = std::stod(value);
+            }
+            else {
+                throw InvalidInputException("Unknown rule for strategy " + name + ": " + rule);
+            }
+        }
+        compiled->tierBonuses = BracketTable(tiers);
+        return compiled;
+    }
+
+    static double evaluate(const Terms& terms, double amount) {
+        return amount * terms.multiplier + terms.flat + terms.tierBonuses.bonus(amount);
+    }
+};
+
+// Strategies loaded with --strategies, in file order
+std::vector<std::unique_ptr<RuleDeposit>> ruleStrategies;
+
+// Function to find a strategy by name, ignoring case: normal, fixed, tiered or one loaded with --strategies.
+// Returns nullptr if there is none.
+const IDeposit* findStrategy(const std::string& name) {
+    static const NormalDeposit normal;
+    static const FixedDeposit fixed;
+    static const TieredDeposit tiered;
+    std::string key = name;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (key == "normal") {
+        return &normal;
+    }
+    if (key == "fixed") {
+        return &fixed;
+    }
+    if (key == "tiered") {
+        return &tiered;
+    }
+    for (const auto& strategy : ruleStrategies) {
+        std::string label = strategy->label();
+        std::transform(label.begin(), label.end(), label.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (label == key) {
+            return strategy.get();
+        }
+    }
+    return nullptr;
+}
+
+// Function to load rule strategies from a file (blank lines and lines starting with '#' are skipped)
+void loadRuleStrategies(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw InvalidInputException("Cannot open strategies file: " + path);
+    }
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        try {
+            auto strategy = std::make_unique<RuleDeposit>(line);
+            if (findStrategy(strategy->label())) {
+                throw InvalidInputException("Strategy " + strategy->label() + " is already defined");
+            }
+            ruleStrategies.push_back(std::move(strategy));
+        }
+        catch (const InvalidInputException& e) {
+            throw InvalidInputException(path + ":" + std::to_string(lineNumber) + ": " + e.what());
+        }
+    }
+}
+
+// Function to change a strategy's parameters while deposits keep running: cap=, bonus=, daily= and
+// monthly=<amount> for fixed, or a full new set of rules for a strategy loaded with --strategies.
+// New daily and monthly limits count deposits from now on (see DepositLimits).
+// Deposits that already read the old parameters finish with them.
+void configureStrategy(const std::string& name, const std::string& rules) {
+    const IDeposit* strategy = findStrategy(name);
+    if (dynamic_cast<const FixedDeposit*>(strategy)) {
+        // Copying the current terms and publishing the edit must not interleave with another
+        // configuration, or one of the two edits would be lost
+        static std::mutex configureMutex;
+        std::lock_guard<std::mutex> lock(configureMutex);
+        auto terms = std::make_unique<FixedDepositTerms>(*FixedDeposit::terms().read());
+        std::istringstream ss(rules);
+        for (std::string rule; ss >> rule;) {
+            size_t equals = rule.find('=');
+            std::string key = rule.substr(0, equals);
+            std::string value = equals == std::string::npos ? "" : rule.substr(equals + 1);
+            if (key == "cap" && isNumeric(value) && std::stod(value) >= 0) {
+                terms->cap = std::stod(value);
+            }
+            else if (key == "bonus" && isNumeric(value)) {
+                terms->bonus = std::stod(value);
+            }
+            else if (key == "daily" && isNumeric(value) && std::stod(value) >= 0) {
+                terms->limits.daily = std::stod(value);
+            }
+            else if (key == "monthly" && isNumeric(value) && std::stod(value) >= 0) {
+                terms->limits.monthly = std::stod(value);
+            }
+            else {
+                throw InvalidInputException("Unknown rule for strategy Fixed: " + rule);
+            }
+        }
+        FixedDeposit::terms().publish(std::move(terms));
+        return;
+    }
+    for (auto& rule : ruleStrategies) {
+        if (rule.get() == strategy) {
+            rule->reconfigure(rules);
+            return;
+        }
+    }
+    throw InvalidInputException(strategy ? "Strategy " + strategy->label() + " has no parameters to configure"
+        : "Unknown strategy: " + name);
+}
+
+// Function to generate a random 6-digit number
+std::string generateRandomID() {
+    std::random_device rd;  // Seed for the random number generator
+    std::mt19937 gen(rd()); // Standard mersenne_twister_engine
+    std::uniform_int_distribution<> dist(100000, 999999); // Range for six-digit number
+
+    std::stringstream ss;
+    ss << "PZ" << dist(gen); // Combine "PZ" with the random number
+    return ss.str();
+}
+
+// Source of randomness for a Bank. Satisfies the UniformRandomBitGenerator requirements so it can
+// drive the standard distributions.
+class RandomSource {
+public:
+    using result_type = unsigned long long;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~0ULL; }
+
+    virtual result_type operator()() = 0;
+    virtual ~RandomSource() {}
+};
+
+// Mersenne twister random source; seeded from std::random_device unless a seed is given
+class MersenneRandom : public RandomSource {
+public:
+    MersenneRandom() : gen(std::random_device()()) {}
+    explicit MersenneRandom(unsigned long long seed) : gen(seed) {}
+
+    result_type operator()() override {
+        return gen();
+    }
+
+private:
+    std::mt19937_64 gen;
+};
+
+// Number of distinct depositor IDs (PZ100000 to PZ999999), and so the most depositors a bank can hold
+constexpr size_t kDepositorIDSpace = 900000;
+
+// Function to reject an account count larger than the ID space
+void checkAccountCount(size_t accounts) {
+    if (accounts > kDepositorIDSpace) {
+        throw InvalidInputException("At most 900000 accounts are supported (IDs run from PZ100000 to PZ999999)");
+    }
+}
+
+// Function to generate a random 6-digit ID from the given random source
+std::string generateRandomID(RandomSource& random) {
+    std::uniform_int_distribution<> dist(100000, 999999); // Range for six-digit number
+    return "PZ" + std::to_string(dist(random));
+}
+
+// Source of time for a Bank, in nanoseconds since the Unix epoch
+class Clock {
+public:
+    virtual long long nowNs() const = 0;
+    virtual ~Clock() {}
+};
+
+// Wall clock
+class SystemClock : public Clock {
+public:
+    long long nowNs() const override {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+};
+
+// Simulated clock for reproducible runs: it only moves when advanced, plus a fixed tick on every
+// reading so that successive events still get distinct, ordered timestamps
+class SimulatedClock : public Clock {
+public:
+    static constexpr long long kDefaultStartNs = 1704067200LL * 1000000000LL; // 2024-01-01T00:00:00Z
+
+    explicit SimulatedClock(long long startNs = kDefaultStartNs, long long tickNs = 1000)
+        : now(startNs), tick(tickNs) {}
+
+    long long nowNs() const override {
+        return now.fetch_add(tick, std::memory_order_relaxed);
+    }
+
+    void advance(long long ns) {
+        now.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+private:
+    mutable std::atomic<long long> now;
+    long long tick;
+};
+
+// Hot-path tracing probes. Building with -DBANK_TRACE makes BANK_TRACE_SPAN(name) record a timestamped
+// span for the enclosing scope into a per-thread buffer; the buffers are written as Chrome trace-event
+// JSON (viewable in chrome://tracing or Perfetto) when the program exits. Without the flag the probes
+// expand to nothing.
+#ifdef BANK_TRACE
+struct TraceEvent {
+    const char* name; // Must be a string literal
+    long long startNs;
+    long long durationNs;
+};
+
+class TraceCollector {
+public:
+    static constexpr size_t kMaxEventsPerThread = 1 << 20;
+
+    struct ThreadBuffer {
+        int threadID;
+        std::vector<TraceEvent> events;
+        unsigned long long dropped = 0;
+    };
+
+    static TraceCollector& instance() {
+        static TraceCollector collector;
+        return collector;
+    }
+
+    static long long nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - instance().origin).count();
+    }
+
+    ThreadBuffer& localBuffer() {
+        thread_local ThreadBuffer* local = nullptr;
+        if (!local) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            local = buffers.back().get();
+            local->threadID = static_cast<int>(buffers.size());
+            local->events.reserve(4096);
+        }
+        return *local;
+    }
+
+    void record(const char* name, long long startNs, long long durationNs) {
+        ThreadBuffer& buffer = localBuffer();
+        if (buffer.events.size() < kMaxEventsPerThread) {
+            buffer.events.push_back({ name, startNs, durationNs });
+        }
+        else {
+            ++buffer.dropped;
+        }
+    }
+
+    void setOutputPath(const std::string& path) {
+        outputPath = path;
+    }
+
+    // Function to write all recorded spans in Chrome trace-event format (timestamps in microseconds)
+    void writeChromeTrace() const {
+        std::ofstream os(outputPath);
+        if (!os) {
+            std::cerr << "Error: cannot write trace file " << outputPath << "\n";
+            return;
+        }
+        std::lock_guard<std::mutex> lock(registryMutex);
+        os << "{\"traceEvents\": [\n";
+        bool first = true;
+        unsigned long long dropped = 0;
+        os << std::fixed << std::setprecision(3);
+        for (const auto& buffer : buffers) {
+            for (const auto& e : buffer->events) {
+                os << (first ? "" : ",\n") << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                    << buffer->threadID << ", \"ts\": " << e.startNs / 1000.0 << ", \"dur\": " << e.durationNs / 1000.0 << "}";
+                first = false;
+            }
+            dropped += buffer->dropped;
+        }
+        os << "\n], \"otherData\": {\"droppedEvents\": " << dropped << "}}\n";
+    }
+
+private:
+    TraceCollector() : origin(std::chrono::steady_clock::now()) {}
+
+    std::chrono::steady_clock::time_point origin;
+    std::string outputPath = "bank_trace.json";
+    mutable std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+// Records the enclosing scope as one complete ("X") trace event
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name(name), start(TraceCollector::nowNs()) {}
+    ~TraceSpan() {
+        TraceCollector::instance().record(name, start, TraceCollector::nowNs() - start);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    long long start;
+};
+
+void writeTraceAtExit() {
+    TraceCollector::instance().writeChromeTrace();
+}
+
+#define BANK_TRACE_CONCAT_INNER(a, b) a##b
+#define BANK_TRACE_CONCAT(a, b) BANK_TRACE_CONCAT_INNER(a, b)
+#define BANK_TRACE_SPAN(name) TraceSpan BANK_TRACE_CONCAT(traceSpan_, __LINE__)(name)
+#else
+#define BANK_TRACE_SPAN(name) ((void)0)
+#endif
+
+// Function to add to an atomic double (compare-and-swap loop; fetch_add for floating point is C++20)
+inline void atomicAdd(std::atomic<double>& target, double delta) {
+    double current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+    }
+}
+
+// Time-indexed entry into an account's transaction chain, kept every few transactions
+struct BalanceCheckpoint {
+    long long timestampNs;
+    unsigned long long reference; // Transaction log reference of the checkpointed transaction
+};
+
+// Function to find the month (counted from January 1970) of a day (counted from 1970-01-01), UTC
+int monthOfDay(long long day) {
+    long long shifted = day + 719468; // Days since 0000-03-01, so leap days end a year
+    long long era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    long long dayOfEra = shifted - era * 146097;
+    long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long long monthFromMarch = (5 * dayOfYear + 2) / 153;
+    long long year = yearOfEra + era * 400 + (monthFromMarch >= 10);
+    long long month = monthFromMarch < 10 ? monthFromMarch + 2 : monthFromMarch - 10; // 0 = January
+    return static_cast<int>((year - 1970) * 12 + month);
+}
+
+// Deposits of one account in its current UTC day and calendar month, in cents, for cumulative limits.
+// Windows are reset lazily: a counter starts over only when a deposit arrives in a later day or month.
+struct DepositWindows {
+    long long dayCents = 0;
+    long long monthCents = 0;
+    int day = std::numeric_limits<int>::min(); // Day the day counter is for
+    int month = std::numeric_limits<int>::min(); // Month the month counter is for
+};
+
+// Depositor class to hold information about a depositor
+class Depositor {
+private:
+    std::string name;
+    std::atomic<double> amount; // Atomic so concurrent deposits and readers need no lock
+    const IDeposit* depositStrategy;
+    std::string depositorID; // String for ID in format PZxxxxxx
+    std::atomic<unsigned long long> lastTransaction{ 0 }; // Newest entry of this account in the transaction log
+    std::vector<BalanceCheckpoint> balanceCheckpoints; // Oldest first; guarded by the account's update lock
+    int strategyGroup; // Group of the strategy in the bank's per-strategy aggregates
+    unsigned int interestCarry = 0; // Interest below one cent, in millionths of a cent, owed to the next period
+    DepositWindows windows; // Guarded by the account's update lock
+
+public:
+    Depositor(const std::string& id, const std::string& name, double amount, const IDeposit* strategy, int strategyGroup = 0)
+        : name(name), amount(amount), depositStrategy(strategy), depositorID(id), strategyGroup(strategyGroup) {}
+
+    double getDepositAmount() const {
+        return depositStrategy->calculateDeposit(amount.load(std::memory_order_relaxed));
+    }
+
+    std::string getName() const {
+        return name;
+    }
+
+    std::string getID() const {
+        return depositorID;
+    }
+
+    bool hasID(const std::string& id) const {
+        return depositorID == id;
+    }
+
+    int getStrategyGroup() const {
+        return strategyGroup;
+    }
+
+    // Balance as stored, without the strategy applied for display
+    double balance() const {
+        return amount.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long lastTransactionReference() const {
+        return lastTransaction.load(std::memory_order_acquire);
+    }
+
+    void setLastTransactionReference(unsigned long long reference) {
+        lastTransaction.store(reference, std::memory_order_release);
+    }
+
+    const std::vector<BalanceCheckpoint>& checkpoints() const {
+        return balanceCheckpoints;
+    }
+
+    void addCheckpoint(long long timestampNs, unsigned long long reference) {
+        balanceCheckpoints.push_back({ timestampNs, reference });
+    }
+
+    size_t checkpointBytes() const {
+        return balanceCheckpoints.capacity() * sizeof(BalanceCheckpoint);
+    }
+
+    // Heap bytes owned by the name and ID strings (0 when they fit the small-string buffer)
+    size_t heapBytes() const {
+        static const size_t inlineCapacity = std::string().capacity();
+        return (name.capacity() > inlineCapacity ? name.capacity() + 1 : 0)
+            + (depositorID.capacity() > inlineCapacity ? depositorID.capacity() + 1 : 0);
+    }
+
+    // Deposits the amount at the given time and returns the amount actually credited (the deposit after
+    // the strategy is applied). With limits, the amount is first counted toward the account's day and
+    // month, and a deposit past either limit is rejected.
+    double deposit(double amount, long long timestampNs, const DepositLimits& limits) {
+        {
+            BANK_TRACE_SPAN("validation");
+            validateDepositAmount(amount);
+        }
+        BANK_TRACE_SPAN("strategy");
+        double credited = depositStrategy->calculateDeposit(amount);
+        if (!std::isfinite(credited) || !std::isfinite(balance() + credited)) {
+            throw InvalidInputException("Deposit amount is too large");
+        }
+        if (limits.any()) {
+            countTowardLimits(amount, limits, timestampNs);
+        }
+        atomicAdd(this->amount, credited); // Add to the deposit amount using strategy
+        return credited;
+    }
+
+    // Counts the amount toward the current day and month, starting a window over if the deposit is past
+    // it. Throws, counting nothing, if either limit would be exceeded. Callers hold the account's update lock.
+    void countTowardLimits(double amount, const DepositLimits& limits, long long timestampNs) {
+        long long nsPerDay = 86400LL * 1000000000LL;
+        int day = static_cast<int>(timestampNs >= 0 ? timestampNs / nsPerDay : (timestampNs + 1) / nsPerDay - 1);
+        DepositWindows next = windows;
+        if (day != next.day) {
+            next.day = day;
+            next.dayCents = 0;
+            int month = monthOfDay(day);
+            if (month != next.month) {
+                next.month = month;
+                next.monthCents = 0;
+            }
+        }
+        long long cents = std::llround(amount * 100);
+        next.dayCents += cents;
+        next.monthCents += cents;
+        if (limits.daily != std::numeric_limits<double>::infinity() && next.dayCents > std::llround(limits.daily * 100)) {
+            throw InvalidInputException("The daily deposit limit for the " + depositStrategy->label() + " account is "
+                + formatGroupedAmount(limits.daily) + " and " + formatGroupedAmount(double(next.dayCents - cents) / 100)
+                + " was already deposited today. Please deposit less.");
+        }
+        if (limits.monthly != std::numeric_limits<double>::infinity() && next.monthCents > std::llround(limits.monthly * 100)) {
+            throw InvalidInputException("The monthly deposit limit for the " + depositStrategy->label() + " account is "
+                + formatGroupedAmount(limits.monthly) + " and " + formatGroupedAmount(double(next.monthCents - cents) / 100)
+                + " was already deposited this month. Please deposit less.");
+        }
+        windows = next;
+    }
+
+    // Current cumulative deposit limits of the account's strategy
+    DepositLimits depositLimits() const {
+        return depositStrategy->depositLimits();
+    }
+
+    // Removes the amount from the balance in one compare-and-swap, so the balance never goes negative
+    void withdraw(double amount) {
+        validateWithdrawalAmount(amount);
+        double current = this->amount.load(std::memory_order_relaxed);
+        do {
+            if (current < amount) {
+                throw InsufficientFundsException();
+            }
+        } while (!this->amount.compare_exchange_weak(current, current - amount, std::memory_order_relaxed));
+    }
+
+    // Applies `periods` periods of compound interest at ratePerMillion (parts per million per period,
+    // negative for fees) in whole cents. The part of each period's interest below one cent is carried
+    // to the next period instead of being rounded away, so the result is exact in cents however many
+    // periods are applied. Returns the change to the balance in cents.
+    long long accrueInterest(long long ratePerMillion, unsigned periods) {
+        double current = amount.load(std::memory_order_relaxed);
+        while (true) {
+            long long startCents = std::llround(current * 100);
+            long long cents = startCents;
+            long long carry = interestCarry;
+            for (unsigned p = 0; p < periods; ++p) {
+                // cents * ratePerMillion can pass 64 bits, so whole millions of cents earn whole cents apart
+                long long whole = cents / 1000000;
+                long long owed = cents % 1000000 * ratePerMillion + carry; // In millionths of a cent
+                long long credit = owed >= 0 ? owed / 1000000 : -((-owed + 999999) / 1000000); // Rounded down
+                carry = owed - credit * 1000000;
+                cents += whole * ratePerMillion + credit;
+            }
+            double updated = current + double(cents - startCents) / 100;
+            if (amount.compare_exchange_weak(current, updated, std::memory_order_relaxed)) {
+                interestCarry = static_cast<unsigned int>(carry);
+                return cents - startCents;
+            }
+        }
+    }
+
+    // Adds an incoming transfer to the balance as is (strategies only apply to deposits)
+    void credit(double amount) {
+        atomicAdd(this->amount, amount);
+    }
+};
+
+// Function to find the index of the highest set bit of a non-zero value
+inline int highestBit(unsigned long long value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// Function to find the index of the lowest set bit of a non-zero value
+inline int lowestBit(unsigned long long value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int bit = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// Function to count the set bits of a value
+inline int popCount(unsigned long long value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(value);
+#else
+    int count = 0;
+    for (; value != 0; value &= value - 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Log-linear latency histogram in the spirit of HdrHistogram: values are grouped by power of two and
+// each power of two is split into linear sub-buckets, giving about 3% relative precision over the full
+// 64-bit range. Only the owning thread records; other threads may read while it records.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    static int bucketIndex(unsigned long long value) {
+        if (value < kSubBuckets) {
+            return static_cast<int>(value);
+        }
+        int magnitude = highestBit(value) - kSubBucketBits;
+        return (magnitude + 1) * kSubBuckets + static_cast<int>((value >> magnitude) - kSubBuckets);
+    }
+
+    // Highest value that falls into the given bucket
+    static unsigned long long bucketUpperBound(int index) {
+        if (index < kSubBuckets) {
+            return static_cast<unsigned long long>(index);
+        }
+        int magnitude = index / kSubBuckets - 1;
+        unsigned long long sub = static_cast<unsigned long long>(index % kSubBuckets + kSubBuckets);
+        return ((sub + 1) << magnitude) - 1;
+    }
+
+    void record(unsigned long long value) {
+        auto& bucket = counts[bucketIndex(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > maximum.load(std::memory_order_relaxed)) {
+            maximum.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < kBucketCount; ++i) {
+            counts[i].fetch_add(other.counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        total.fetch_add(other.count(), std::memory_order_relaxed);
+        if (other.max() > max()) {
+            maximum.store(other.max(), std::memory_order_relaxed);
+        }
+    }
+
+    unsigned long long count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long max() const {
+        return maximum.load(std::memory_order_relaxed);
+    }
+
+    // Value below which the given fraction (0..1) of recorded values fall, at bucket precision
+    unsigned long long percentile(double fraction) const {
+        unsigned long long n = count();
+        if (n == 0) {
+            return 0;
+        }
+        unsigned long long rank = static_cast<unsigned long long>(std::ceil(fraction * n));
+        rank = rank == 0 ? 1 : rank;
+        unsigned long long seen = 0;
+        for (int i = 0; i < kBucketCount; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(bucketUpperBound(i), max());
+            }
+        }
+        return max();
+    }
+
+private:
+    std::array<std::atomic<unsigned long long>, kBucketCount> counts{};
+    std::atomic<unsigned long long> total{ 0 };
+    std::atomic<unsigned long long> maximum{ 0 };
+};
+
+// Bank operations that are instrumented with latency histograms
+enum class BankOperation { Add, Deposit, Total, List, Withdraw, Transfer, DepositBatch, Count };
+
+const char* operationName(BankOperation op) {
+    switch (op) {
+    case BankOperation::Add: return "add";
+    case BankOperation::Deposit: return "deposit";
+    case BankOperation::Total: return "total";
+    case BankOperation::List: return "list";
+    case BankOperation::Withdraw: return "withdraw";
+    case BankOperation::Transfer: return "transfer";
+    case BankOperation::DepositBatch: return "deposit-many";
+    default: return "unknown";
+    }
+}
+
+// Process-wide latency recorder. Each thread records into its own set of histograms (no sharing on the
+// hot path); the sets are merged only when statistics are requested. Recording is off until enabled.
+class LatencyRecorder {
+public:
+    static constexpr size_t kOperations = static_cast<size_t>(BankOperation::Count);
+    using HistogramSet = std::array<LatencyHistogram, kOperations>;
+
+    static LatencyRecorder& instance() {
+        static LatencyRecorder recorder;
+        return recorder;
+    }
+
+    bool enabled() const {
+        return isEnabled.load(std::memory_order_relaxed);
+    }
+
+    void enable() {
+        isEnabled.store(true, std::memory_order_relaxed);
+    }
+
+    void record(BankOperation op, unsigned long long nanoseconds) {
+        thread_local HistogramSet* local = nullptr;
+        if (!local) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            threadSets.push_back(std::make_unique<HistogramSet>());
+            local = threadSets.back().get();
+        }
+        (*local)[static_cast<size_t>(op)].record(nanoseconds);
+    }
+
+    // Function to merge the per-thread histograms into one set
+    std::unique_ptr<HistogramSet> merged() const {
+        auto result = std::make_unique<HistogramSet>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& set : threadSets) {
+            for (size_t i = 0; i < kOperations; ++i) {
+                (*result)[i].merge((*set)[i]);
+            }
+        }
+        return result;
+    }
+
+    void report(std::ostream& os) const {
+        if (!enabled()) {
+            os << "Latency statistics are disabled (start the program with --stats).\n";
+            return;
+        }
+        auto set = merged();
+        os << "\nOperation latency (ns):\n";
+        os << std::left << std::setw(14) << "operation" << std::right << std::setw(12) << "count"
+            << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "p99.9"
+            << std::setw(12) << "max" << "\n";
+        for (size_t i = 0; i < kOperations; ++i) {
+            const auto& h = (*set)[i];
+            os << std::left << std::setw(14) << operationName(static_cast<BankOperation>(i)) << std::right
+                << std::setw(12) << h.count() << std::setw(12) << h.percentile(0.5)
+                << std::setw(12) << h.percentile(0.99) << std::setw(12) << h.percentile(0.999)
+                << std::setw(12) << h.max() << "\n";
+        }
+    }
+
+private:
+    LatencyRecorder() = default;
+
+    std::atomic<bool> isEnabled{ false };
+    mutable std::mutex registryMutex;
+    std::vector<std::unique_ptr<HistogramSet>> threadSets; // Kept after threads exit so their samples survive
+};
+
+// Records the latency of the enclosing scope into the recorder (a single flag check when disabled)
+class ScopedLatency {
+public:
+    explicit ScopedLatency(BankOperation op) : op(op), active(LatencyRecorder::instance().enabled()) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedLatency() {
+        if (active) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            LatencyRecorder::instance().record(op,
+                static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    BankOperation op;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+static_assert(static_cast<int>(BankOperation::Count) <= kAllocationScopes, "too many operations for allocation tracking");
+
+// Live counters of a Bank, updated on the hot path with relaxed atomics and read by the metrics endpoint
+struct BankMetrics {
+    enum Rejection { InvalidInput, NegativeDeposit, InsufficientFunds, UnknownAccount, RejectionCount };
+
+    std::atomic<unsigned long long> accounts{ 0 };
+    std::atomic<unsigned long long> deposits{ 0 };
+    std::atomic<unsigned long long> withdrawals{ 0 };
+    std::atomic<unsigned long long> transfers{ 0 };
+    std::array<std::atomic<unsigned long long>, RejectionCount> rejectedDeposits{};
+    std::array<std::atomic<unsigned long long>, RejectionCount> rejectedDebits{}; // Withdrawals and transfers
+    std::atomic<double> totalBalance{ 0 };        // Sum of all balances (strategy bonuses included)
+    std::atomic<long long> operationsInFlight{ 0 };
+
+    static const char* rejectionName(int reason) {
+        static const char* names[RejectionCount] = {
+            "InvalidInputException", "NegativeDepositException", "InsufficientFundsException", "UnknownAccount" };
+        return names[reason];
+    }
+
+    void reject(Rejection reason) {
+        rejectedDeposits[reason].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void rejectDebit(Rejection reason) {
+        rejectedDebits[reason].fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// Marks the enclosing scope as one Bank operation: records its latency, attributes its allocations
+// and counts it as in flight for the bank's metrics
+class OperationScope {
+public:
+    OperationScope(BankOperation op, BankMetrics& metrics)
+        : latency(op), previous(currentAllocationScope), inFlight(metrics.operationsInFlight) {
+        inFlight.fetch_add(1, std::memory_order_relaxed);
+        currentAllocationScope = static_cast<int>(op);
+        if (allocationTrackingEnabled.load(std::memory_order_relaxed)) {
+            scopeOperations[static_cast<int>(op)].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ~OperationScope() {
+        currentAllocationScope = previous;
+        inFlight.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    OperationScope(const OperationScope&) = delete;
+    OperationScope& operator=(const OperationScope&) = delete;
+
+private:
+    ScopedLatency latency;
+    int previous;
+    std::atomic<long long>& inFlight;
+};
+
+// Function to print allocations and bytes attributed to each Bank operation
+void reportAllocations(std::ostream& os) {
+    os << "\nAllocations by operation:\n";
+    os << std::left << std::setw(22) << "operation" << std::right << std::setw(12) << "calls"
+        << std::setw(14) << "allocations" << std::setw(16) << "bytes" << std::setw(12) << "allocs/op"
+        << std::setw(12) << "bytes/op" << "\n";
+    unsigned long long attributedCount = 0;
+    unsigned long long attributedBytes = 0;
+    os << std::fixed << std::setprecision(2);
+    for (int i = 0; i < static_cast<int>(BankOperation::Count); ++i) {
+        unsigned long long calls = scopeOperations[i].load(std::memory_order_relaxed);
+        unsigned long long count = scopeAllocationCount[i].load(std::memory_order_relaxed);
+        unsigned long long bytes = scopeAllocatedBytes[i].load(std::memory_order_relaxed);
+        attributedCount += count;
+        attributedBytes += bytes;
+        os << std::left << std::setw(22) << operationName(static_cast<BankOperation>(i)) << std::right
+            << std::setw(12) << calls << std::setw(14) << count << std::setw(16) << bytes
+            << std::setw(12) << (calls ? double(count) / calls : 0.0)
+            << std::setw(12) << (calls ? double(bytes) / calls : 0.0) << "\n";
+    }
+    os << std::defaultfloat;
+    // Everything else, including allocations made while tracking was off (e.g. strategy objects in the menu)
+    os << std::left << std::setw(22) << "(outside operations)" << std::right << std::setw(12) << "-"
+        << std::setw(14) << allocationCount.load(std::memory_order_relaxed) - attributedCount
+        << std::setw(16) << allocatedBytes.load(std::memory_order_relaxed) - attributedBytes << "\n";
+}
+
+// Function to print every enabled operation statistic (latency and/or allocations)
+void printOperationStats(std::ostream& os) {
+    bool latencyEnabled = LatencyRecorder::instance().enabled();
+    bool allocationsEnabled = allocationTrackingEnabled.load(std::memory_order_relaxed);
+    if (!latencyEnabled && !allocationsEnabled) {
+        os << "Operation statistics are disabled (start the program with --stats and/or --alloc-track).\n";
+        return;
+    }
+    if (latencyEnabled) {
+        LatencyRecorder::instance().report(os);
+    }
+    if (allocationsEnabled) {
+        reportAllocations(os);
+    }
+}
+
+// Function used with std::atexit to dump operation statistics when the program ends
+void dumpOperationStats() {
+    printOperationStats(std::cerr);
+}
+
+// Append-only array whose elements never move once constructed. Segment k holds kFirstSegment << k
+// elements, so growing never relocates existing elements and readers can index it without locking
+// while a single writer appends (the element count is published with a release store).
+template <typename T>
+class StableVector {
+public:
+    static constexpr size_t kFirstSegment = 1024;
+    static constexpr int kMaxSegments = 40;
+
+    StableVector() = default;
+    StableVector(const StableVector&) = delete;
+    StableVector& operator=(const StableVector&) = delete;
+
+    ~StableVector() {
+        size_t n = count.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < n; ++i) {
+            (*this)[i].~T();
+        }
+        for (auto& segment : segments) {
+            ::operator delete(segment.load(std::memory_order_relaxed));
+        }
+    }
+
+    size_t size() const {
+        return count.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    T& operator[](size_t index) {
+        size_t segment, offset;
+        locate(index, segment, offset);
+        return segments[segment].load(std::memory_order_acquire)[offset];
+    }
+
+    const T& operator[](size_t index) const {
+        return const_cast<StableVector&>(*this)[index];
+    }
+
+    // Appends an element; callers must serialize appends
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        size_t index = count.load(std::memory_order_relaxed);
+        size_t segment, offset;
+        locate(index, segment, offset);
+        T* storage = segments[segment].load(std::memory_order_relaxed);
+        if (!storage) {
+            storage = static_cast<T*>(::operator new(sizeof(T) * (kFirstSegment << segment)));
+            segments[segment].store(storage, std::memory_order_release);
+        }
+        T* element = new (storage + offset) T(std::forward<Args>(args)...);
+        count.store(index + 1, std::memory_order_release);
+        return *element;
+    }
+
+    // Bytes reserved by the allocated segments
+    size_t capacityBytes() const {
+        size_t bytes = 0;
+        for (int k = 0; k < kMaxSegments; ++k) {
+            if (segments[k].load(std::memory_order_relaxed)) {
+                bytes += sizeof(T) * (kFirstSegment << k);
+            }
+        }
+        return bytes;
+    }
+
+private:
+    static void locate(size_t index, size_t& segment, size_t& offset) {
+        segment = static_cast<size_t>(highestBit(index / kFirstSegment + 1));
+        offset = index - kFirstSegment * ((size_t(1) << segment) - 1);
+    }
+
+    std::array<std::atomic<T*>, kMaxSegments> segments{};
+    std::atomic<size_t> count{ 0 };
+};
+
+// Insert-only hash index from depositor ID to storage slot. Lookups never lock: entries are published
+// with release stores, and when the table fills up it is replaced by a larger copy rather than resized
+// in place. Replaced tables are kept until the index is destroyed so concurrent readers stay valid.
+// When an ID is inserted twice the first slot wins, matching a front-to-back scan.
+class IdIndex {
+public:
+    IdIndex() {
+        tables.push_back(std::make_unique<Table>(1024));
+        current.store(tables.back().get(), std::memory_order_release);
+    }
+
+    // Returns the slot holding the ID, or -1; matches(slot) must compare the ID stored in that slot
+    template <typename Matches>
+    long long find(const std::string& id, Matches matches) const {
+        const Table* table = current.load(std::memory_order_acquire);
+        size_t hash = std::hash<std::string>()(id);
+        for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+            unsigned long long entry = table->entries[i].load(std::memory_order_acquire);
+            if (entry == 0) {
+                return -1;
+            }
+            if ((entry >> kSlotBits) == tagOf(hash) && matches(slotOf(entry))) {
+                return static_cast<long long>(slotOf(entry));
+            }
+        }
+    }
+
+    // Adds an ID (callers must serialize inserts); idOf(slot) returns the ID stored in a slot
+    template <typename IdOf>
+    void insert(const std::string& id, size_t slot, IdOf idOf) {
+        if (find(id, [&](size_t other) { return idOf(other) == id; }) >= 0) {
+            return;
+        }
+        Table* table = tables.back().get(); // The newest table is the current one
+        if ((used + 1) * 2 > table->mask + 1) {
+            auto larger = std::make_unique<Table>((table->mask + 1) * 2);
+            for (size_t i = 0; i <= table->mask; ++i) {
+                unsigned long long entry = table->entries[i].load(std::memory_order_relaxed);
+                if (entry != 0) {
+                    place(*larger, std::hash<std::string>()(idOf(slotOf(entry))), entry);
+                }
+            }
+            tables.push_back(std::move(larger));
+            table = tables.back().get();
+            current.store(table, std::memory_order_release);
+        }
+        size_t hash = std::hash<std::string>()(id);
+        place(*table, hash, (tagOf(hash) << kSlotBits) | (slot + 1));
+        ++used;
+    }
+
+    // Bytes held by the current table and the replaced ones still kept alive
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const auto& table : tables) {
+            bytes += sizeof(Table) + (table->mask + 1) * sizeof(std::atomic<unsigned long long>);
+        }
+        return bytes;
+    }
+
+private:
+    // Entry layout: high bits are a hash tag (to skip most string compares), low bits are slot + 1; 0 is empty
+    static constexpr int kSlotBits = 40;
+
+    struct Table {
+        explicit Table(size_t capacity)
+            : mask(capacity - 1), entries(new std::atomic<unsigned long long>[capacity]) {
+            for (size_t i = 0; i < capacity; ++i) {
+                entries[i].store(0, std::memory_order_relaxed);
+            }
+        }
+        size_t mask;
+        std::unique_ptr<std::atomic<unsigned long long>[]> entries;
+    };
+
+    static unsigned long long tagOf(size_t hash) {
+        return static_cast<unsigned long long>(hash) >> kSlotBits;
+    }
+
+    static size_t slotOf(unsigned long long entry) {
+        return static_cast<size_t>((entry & ((1ULL << kSlotBits) - 1)) - 1);
+    }
+
+    static void place(Table& table, size_t hash, unsigned long long entry) {
+        size_t i = hash & table.mask;
+        while (table.entries[i].load(std::memory_order_relaxed) != 0) {
+            i = (i + 1) & table.mask;
+        }
+        table.entries[i].store(entry, std::memory_order_release);
+    }
+
+    std::atomic<const Table*> current{ nullptr };
+    std::vector<std::unique_ptr<Table>> tables; // Writer-only
+    size_t used = 0;                            // Writer-only
+};
+
+// Kind of a recorded transaction
+enum class TransactionKind : unsigned char { Deposit, Withdrawal, TransferIn, TransferOut, Interest };
+
+const char* transactionKindName(TransactionKind kind) {
+    switch (kind) {
+    case TransactionKind::Deposit: return "deposit";
+    case TransactionKind::Withdrawal: return "withdrawal";
+    case TransactionKind::TransferIn: return "transfer in";
+    case TransactionKind::Interest: return "interest";
+    default: return "transfer out";
+    }
+}
+
+// One entry of the transaction log
+struct Transaction {
+    long long timestampNs;
+    double amount;               // Change to the balance (negative when money leaves the account)
+    double balanceAfter;
+    unsigned long long previous; // Reference of the account's previous transaction, 0 if none
+    unsigned int sequence;       // 1 for the account's first transaction, 2 for the next, ...
+    TransactionKind kind;
+};
+
+// Shared append-only transaction log. Appending reserves a position with one atomic increment and
+// writes it into a segment that is allocated once for many transactions (segment k holds
+// kFirstSegment << k entries), so recording is O(1) and never allocates per transaction. Entries are
+// addressed by reference = position + 1, so 0 can mean "no transaction"; each account chains its own
+// entries through Transaction::previous.
+class TransactionLog {
+public:
+    static constexpr size_t kFirstSegment = 4096;
+    static constexpr int kMaxSegments = 40;
+
+    TransactionLog() = default;
+    TransactionLog(const TransactionLog&) = delete;
+    TransactionLog& operator=(const TransactionLog&) = delete;
+
+    ~TransactionLog() {
+        for (auto& segment : segments) {
+            delete[] segment.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Stores the transaction and returns its reference; safe to call from several threads
+    unsigned long long append(const Transaction& transaction) {
+        size_t position = tail.fetch_add(1, std::memory_order_relaxed);
+        size_t segment, offset;
+        locate(position, segment, offset);
+        Transaction* storage = segments[segment].load(std::memory_order_acquire);
+        if (!storage) {
+            Transaction* fresh = new Transaction[kFirstSegment << segment];
+            if (segments[segment].compare_exchange_strong(storage, fresh, std::memory_order_acq_rel)) {
+                storage = fresh;
+            }
+            else {
+                delete[] fresh; // Another thread installed the segment first
+            }
+        }
+        storage[offset] = transaction;
+        return position + 1;
+    }
+
+    // Entry for a reference returned by append; the caller must have seen the reference published
+    const Transaction& at(unsigned long long reference) const {
+        size_t segment, offset;
+        locate(static_cast<size_t>(reference - 1), segment, offset);
+        return segments[segment].load(std::memory_order_acquire)[offset];
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_relaxed);
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (int k = 0; k < kMaxSegments; ++k) {
+            if (segments[k].load(std::memory_order_relaxed)) {
+                bytes += sizeof(Transaction) * (kFirstSegment << k);
+            }
+        }
+        return bytes;
+    }
+
+private:
+    static void locate(size_t position, size_t& segment, size_t& offset) {
+        segment = static_cast<size_t>(highestBit(position / kFirstSegment + 1));
+        offset = position - kFirstSegment * ((size_t(1) << segment) - 1);
+    }
+
+    std::array<std::atomic<Transaction*>, kMaxSegments> segments{};
+    std::atomic<size_t> tail{ 0 };
+};
+
+// Function to format a timestamp in nanoseconds since the epoch as UTC date and time with microseconds
+std::string formatTimestamp(long long ns) {
+    std::time_t seconds = static_cast<std::time_t>(ns / 1000000000LL);
+    std::tm parts = *std::gmtime(&seconds);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &parts);
+    char micros[16];
+    std::snprintf(micros, sizeof(micros), ".%06lld", (ns % 1000000000LL) / 1000);
+    return std::string(text) + micros;
+}
+
+// Function to parse a UTC timestamp written as YYYY-MM-DDTHH:MM:SS[.fraction] into nanoseconds since the epoch
+long long parseTimestamp(const std::string& text) {
+    int year, month, day, hour, minute;
+    double second;
+    char separator;
+    if (std::sscanf(text.c_str(), "%d-%d-%d%c%d:%d:%lf", &year, &month, &day, &separator, &hour, &minute, &second) != 7 ||
+        (separator != 'T' && separator != 't') || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second >= 61) {
+        throw InvalidInputException("Invalid timestamp (expected YYYY-MM-DDTHH:MM:SS): " + text);
+    }
+    // Days since 1970-01-01 in the proleptic Gregorian calendar
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    long long days = static_cast<long long>(era) * 146097 + dayOfEra - 719468;
+    long long seconds = days * 86400 + hour * 3600 + minute * 60;
+    return seconds * 1000000000LL + static_cast<long long>(std::llround(second * 1e9));
+}
+
+// Function to print transactions, one per line
+void printTransactions(const std::vector<Transaction>& transactions, std::ostream& os) {
+    if (transactions.empty()) {
+        os << "No transactions recorded.\n";
+        return;
+    }
+    for (const auto& t : transactions) {
+        os << formatTimestamp(t.timestampNs) << "  " << std::left << std::setw(13) << transactionKindName(t.kind)
+            << std::right << std::setw(14) << std::showpos << t.amount << std::noshowpos
+            << "  balance " << t.balanceAfter << "\n";
+    }
+}
+
+// Secondary index of accounts ordered by stored balance (ties broken by slot), updated on every balance
+// change so ordered queries need neither a scan nor a sort. It is a B+tree: leaves hold up to
+// kLeafCapacity sorted entries in one contiguous array and are linked for range scans, and inner nodes
+// keep the entry count of each child so counting a range takes O(log n). Not thread-safe; the bank
+// serializes access.
+class BalanceIndex {
+public:
+    struct Key {
+        double balance;
+        size_t slot;
+
+        bool operator<(const Key& other) const {
+            return balance < other.balance || (balance == other.balance && slot < other.slot);
+        }
+        bool operator==(const Key& other) const {
+            return balance == other.balance && slot == other.slot;
+        }
+    };
+
+    static constexpr int kLeafCapacity = 32;  // 16-byte entries: a leaf's keys span eight cache lines
+    static constexpr int kInnerCapacity = 32;
+
+    BalanceIndex() : root(new Leaf()) {
+        ++leafCount;
+    }
+
+    BalanceIndex(const BalanceIndex&) = delete;
+    BalanceIndex& operator=(const BalanceIndex&) = delete;
+
+    ~BalanceIndex() {
+        destroy(root);
+    }
+
+    void insert(double balance, size_t slot) {
+        Key key{ balance, slot };
+        Key splitKey;
+        if (Node* sibling = insertInto(root, key, splitKey)) {
+            Inner* newRoot = new Inner();
+            ++innerCount;
+            newRoot->size = 2;
+            newRoot->children[0] = root;
+            newRoot->children[1] = sibling;
+            newRoot->separators[0] = Key{ -HUGE_VAL, 0 };
+            newRoot->separators[1] = splitKey;
+            newRoot->counts[0] = countOf(root);
+            newRoot->counts[1] = countOf(sibling);
+            root = newRoot;
+        }
+        ++entries;
+    }
+
+    // Moves an account from its old balance to its new one in O(log n)
+    void update(double before, double after, size_t slot) {
+        if (before == after) {
+            return;
+        }
+        erase(before, slot);
+        insert(after, slot);
+    }
+
+    void erase(double balance, size_t slot) {
+        if (!eraseFrom(root, Key{ balance, slot })) {
+            return;
+        }
+        --entries;
+        if (!root->leaf && root->size == 1) {
+            Inner* old = static_cast<Inner*>(root);
+            root = old->children[0];
+            delete old;
+            --innerCount;
+        }
+    }
+
+    // Calls visit(slot, balance) for up to count accounts with the largest balances, largest first
+    template <typename Visit>
+    void forEachLargest(size_t count, Visit visit) const {
+        const Node* node = root;
+        while (!node->leaf) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            node = inner->children[inner->size - 1];
+        }
+        for (const Leaf* leaf = static_cast<const Leaf*>(node); leaf && count > 0; leaf = leaf->prev) {
+            for (int i = leaf->size - 1; i >= 0 && count > 0; --i, --count) {
+                visit(leaf->keys[i].slot, leaf->keys[i].balance);
+            }
+        }
+    }
+
+    // Calls visit(slot, balance) for every account with low <= balance <= high, in ascending order;
+    // O(log n + k) for k results
+    template <typename Visit>
+    void forEachInRange(double low, double high, Visit visit) const {
+        Key first{ low, 0 };
+        const Leaf* leaf = leafFor(first);
+        int i = static_cast<int>(std::lower_bound(leaf->keys, leaf->keys + leaf->size, first) - leaf->keys);
+        for (; leaf; leaf = leaf->next, i = 0) {
+            for (; i < leaf->size; ++i) {
+                if (leaf->keys[i].balance > high) {
+                    return;
+                }
+                visit(leaf->keys[i].slot, leaf->keys[i].balance);
+            }
+        }
+    }
+
+    // Finds the lowest entry with low <= balance <= high whose slot satisfies the predicate
+    template <typename Predicate>
+    bool findLowest(double low, double high, Predicate matches, Key& found) const {
+        const Leaf* leaf = leafFor(Key{ low, 0 });
+        int i = static_cast<int>(std::lower_bound(leaf->keys, leaf->keys + leaf->size, Key{ low, 0 }) - leaf->keys);
+        for (; leaf; leaf = leaf->next, i = 0) {
+            for (; i < leaf->size && leaf->keys[i].balance <= high; ++i) {
+                if (matches(leaf->keys[i].slot)) {
+                    found = leaf->keys[i];
+                    return true;
+                }
+            }
+            if (i < leaf->size) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    // Finds the highest entry with low <= balance <= high whose slot satisfies the predicate
+    template <typename Predicate>
+    bool findHighest(double low, double high, Predicate matches, Key& found) const {
+        Key last{ high, SIZE_MAX };
+        const Leaf* leaf = leafFor(last);
+        int i = static_cast<int>(std::upper_bound(leaf->keys, leaf->keys + leaf->size, last) - leaf->keys) - 1;
+        for (; leaf; leaf = leaf->prev, i = leaf ? leaf->size - 1 : 0) {
+            for (; i >= 0 && leaf->keys[i].balance >= low; --i) {
+                if (matches(leaf->keys[i].slot)) {
+                    found = leaf->keys[i];
+                    return true;
+                }
+            }
+            if (i >= 0) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    // Number of accounts with low <= balance <= high, in O(log n)
+    size_t countInRange(double low, double high) const {
+        if (high < low) {
+            return 0;
+        }
+        return countBelow(Key{ high, SIZE_MAX }) - countBelow(Key{ low, 0 });
+    }
+
+    // Number of entries ordered before the key
+    size_t countBelow(const Key& key) const {
+        size_t below = 0;
+        const Node* node = root;
+        while (!node->leaf) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            int i = childIndex(inner, key);
+            for (int j = 0; j < i; ++j) {
+                below += inner->counts[j];
+            }
+            node = inner->children[i];
+        }
+        const Leaf* leaf = static_cast<const Leaf*>(node);
+        return below + (std::lower_bound(leaf->keys, leaf->keys + leaf->size, key) - leaf->keys);
+    }
+
+    size_t size() const {
+        return entries;
+    }
+
+    size_t memoryBytes() const {
+        return leafCount * sizeof(Leaf) + innerCount * sizeof(Inner);
+    }
+
+private:
+    struct Node {
+        bool leaf;
+        int size = 0; // Entries in a leaf, children in an inner node
+        explicit Node(bool leaf) : leaf(leaf) {}
+    };
+
+    // Arrays have one spare element so a node can overflow by one before it is split
+    struct Leaf : Node {
+        Leaf() : Node(true) {}
+        Key keys[kLeafCapacity + 1];
+        Leaf* prev = nullptr;
+        Leaf* next = nullptr;
+    };
+
+    // separators[i] is a lower bound of child i's keys and an upper bound of child i - 1's
+    struct Inner : Node {
+        Inner() : Node(false) {}
+        Key separators[kInnerCapacity + 1];
+        Node* children[kInnerCapacity + 1];
+        size_t counts[kInnerCapacity + 1];
+    };
+
+    const Leaf* leafFor(const Key& key) const {
+        const Node* node = root;
+        while (!node->leaf) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            node = inner->children[childIndex(inner, key)];
+        }
+        return static_cast<const Leaf*>(node);
+    }
+
+    static int childIndex(const Inner* inner, const Key& key) {
+        return static_cast<int>(std::upper_bound(inner->separators + 1, inner->separators + inner->size, key)
+            - inner->separators) - 1;
+    }
+
+    static size_t countOf(const Node* node) {
+        if (node->leaf) {
+            return static_cast<size_t>(node->size);
+        }
+        const Inner* inner = static_cast<const Inner*>(node);
+        size_t count = 0;
+        for (int i = 0; i < inner->size; ++i) {
+            count += inner->counts[i];
+        }
+        return count;
+    }
+
+    // Inserts below node; when the node splits, returns the new right sibling and its lowest key
+    Node* insertInto(Node* node, const Key& key, Key& splitKey) {
+        if (node->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            int i = static_cast<int>(std::lower_bound(leaf->keys, leaf->keys + leaf->size, key) - leaf->keys);
+            std::copy_backward(leaf->keys + i, leaf->keys + leaf->size, leaf->keys + leaf->size + 1);
+            leaf->keys[i] = key;
+            if (++leaf->size <= kLeafCapacity) {
+                return nullptr;
+            }
+            Leaf* right = new Leaf();
+            ++leafCount;
+            int half = leaf->size / 2;
+            right->size = leaf->size - half;
+            std::copy(leaf->keys + half, leaf->keys + leaf->size, right->keys);
+            leaf->size = half;
+            right->next = leaf->next;
+            right->prev = leaf;
+            if (leaf->next) {
+                leaf->next->prev = right;
+            }
+            leaf->next = right;
+            splitKey = right->keys[0];
+            return right;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        int i = childIndex(inner, key);
+        Key childSplitKey;
+        Node* sibling = insertInto(inner->children[i], key, childSplitKey);
+        if (!sibling) {
+            ++inner->counts[i];
+            return nullptr;
+        }
+        std::copy_backward(inner->separators + i + 1, inner->separators + inner->size, inner->separators + inner->size + 1);
+        std::copy_backward(inner->children + i + 1, inner->children + inner->size, inner->children + inner->size + 1);
+        std::copy_backward(inner->counts + i + 1, inner->counts + inner->size, inner->counts + inner->size + 1);
+        inner->separators[i + 1] = childSplitKey;
+        inner->children[i + 1] = sibling;
+        inner->counts[i] = countOf(inner->children[i]);
+        inner->counts[i + 1] = countOf(sibling);
+        if (++inner->size <= kInnerCapacity) {
+            return nullptr;
+        }
+        Inner* right = new Inner();
+        ++innerCount;
+        int half = inner->size / 2;
+        right->size = inner->size - half;
+        std::copy(inner->separators + half, inner->separators + inner->size, right->separators);
+        std::copy(inner->children + half, inner->children + inner->size, right->children);
+        std::copy(inner->counts + half, inner->counts + inner->size, right->counts);
+        inner->size = half;
+        splitKey = right->separators[0];
+        return right;
+    }
+
+    // Removes the key below node; returns false if it was not present
+    bool eraseFrom(Node* node, const Key& key) {
+        if (node->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            Key* found = std::lower_bound(leaf->keys, leaf->keys + leaf->size, key);
+            if (found == leaf->keys + leaf->size || !(*found == key)) {
+                return false;
+            }
+            std::copy(found + 1, leaf->keys + leaf->size, found);
+            --leaf->size;
+            return true;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        int i = childIndex(inner, key);
+        if (!eraseFrom(inner->children[i], key)) {
+            return false;
+        }
+        --inner->counts[i];
+        Node* child = inner->children[i];
+        int minimum = (child->leaf ? kLeafCapacity : kInnerCapacity) / 2;
+        if (child->size < minimum && inner->size > 1) {
+            rebalance(inner, i + 1 < inner->size ? i : i - 1);
+        }
+        return true;
+    }
+
+    // Merges children left and left + 1 of the parent if they fit in one node, otherwise evens them out
+    void rebalance(Inner* parent, int left) {
+        int right = left + 1;
+        Node* l = parent->children[left];
+        Node* r = parent->children[right];
+        int capacity = l->leaf ? kLeafCapacity : kInnerCapacity;
+        if (!l->leaf) {
+            // The parent's separator is the exact boundary; the right node's own first separator may be stale
+            static_cast<Inner*>(r)->separators[0] = parent->separators[right];
+        }
+
+        if (l->size + r->size <= capacity) {
+            if (l->leaf) {
+                Leaf* ll = static_cast<Leaf*>(l);
+                Leaf* rl = static_cast<Leaf*>(r);
+                std::copy(rl->keys, rl->keys + rl->size, ll->keys + ll->size);
+                ll->size += rl->size;
+                ll->next = rl->next;
+                if (rl->next) {
+                    rl->next->prev = ll;
+                }
+                delete rl;
+                --leafCount;
+            }
+            else {
+                Inner* li = static_cast<Inner*>(l);
+                Inner* ri = static_cast<Inner*>(r);
+                std::copy(ri->separators, ri->separators + ri->size, li->separators + li->size);
+                std::copy(ri->children, ri->children + ri->size, li->children + li->size);
+                std::copy(ri->counts, ri->counts + ri->size, li->counts + li->size);
+                li->size += ri->size;
+                delete ri;
+                --innerCount;
+            }
+            parent->counts[left] += parent->counts[right];
+            std::copy(parent->separators + right + 1, parent->separators + parent->size, parent->separators + right);
+            std::copy(parent->children + right + 1, parent->children + parent->size, parent->children + right);
+            std::copy(parent->counts + right + 1, parent->counts + parent->size, parent->counts + right);
+            --parent->size;
+            return;
+        }
+
+        int total = l->size + r->size;
+        int leftSize = total / 2;
+        if (l->leaf) {
+            Leaf* ll = static_cast<Leaf*>(l);
+            Leaf* rl = static_cast<Leaf*>(r);
+            if (ll->size < leftSize) {
+                int move = leftSize - ll->size;
+                std::copy(rl->keys, rl->keys + move, ll->keys + ll->size);
+                std::copy(rl->keys + move, rl->keys + rl->size, rl->keys);
+            }
+            else {
+                int move = ll->size - leftSize;
+                std::copy_backward(rl->keys, rl->keys + rl->size, rl->keys + rl->size + move);
+                std::copy(ll->keys + leftSize, ll->keys + ll->size, rl->keys);
+            }
+            parent->separators[right] = rl->keys[0];
+        }
+        else {
+            Inner* li = static_cast<Inner*>(l);
+            Inner* ri = static_cast<Inner*>(r);
+            auto shift = [&](auto Inner::*array) {
+                auto* la = li->*array;
+                auto* ra = ri->*array;
+                if (li->size < leftSize) {
+                    int move = leftSize - li->size;
+                    std::copy(ra, ra + move, la + li->size);
+                    std::copy(ra + move, ra + ri->size, ra);
+                }
+                else {
+                    int move = li->size - leftSize;
+                    std::copy_backward(ra, ra + ri->size, ra + ri->size + move);
+                    std::copy(la + leftSize, la + li->size, ra);
+                }
+            };
+            shift(&Inner::separators);
+            shift(&Inner::children);
+            shift(&Inner::counts);
+            parent->separators[right] = ri->separators[0];
+        }
+        l->size = leftSize;
+        r->size = total - leftSize;
+        parent->counts[left] = countOf(l);
+        parent->counts[right] = countOf(r);
+    }
+
+    void destroy(Node* node) {
+        if (!node->leaf) {
+            Inner* inner = static_cast<Inner*>(node);
+            for (int i = 0; i < inner->size; ++i) {
+                destroy(inner->children[i]);
+            }
+            delete inner;
+        }
+        else {
+            delete static_cast<Leaf*>(node);
+        }
+    }
+
+    Node* root;
+    size_t entries = 0;
+    size_t leafCount = 0;
+    size_t innerCount = 0;
+};
+
+// Distribution of stored balances over the log-linear buckets of LatencyHistogram (balances in cents,
+// about 3% wide), kept as two Fenwick trees: accounts per bucket and cents per bucket. Prefix counts
+// and sums cost O(log buckets) and stay exact under repeated updates because they are integers.
+// Not thread-safe; the bank serializes access.
+class BalanceDistribution {
+public:
+    static constexpr int kBuckets = LatencyHistogram::kBucketCount;
+
+    void add(double balance) {
+        apply(balance, 1);
+    }
+
+    void update(double before, double after) {
+        if (before != after) {
+            apply(before, -1);
+            apply(after, 1);
+        }
+    }
+
+    size_t count() const {
+        return static_cast<size_t>(prefixCount(kBuckets));
+    }
+
+    // Total held by the `accounts` smallest balances. Whole buckets are summed exactly; the bucket the
+    // boundary falls in contributes its mean balance for each account taken from it.
+    double totalOfSmallest(size_t accounts) const {
+        size_t position = 0;
+        long long remaining = static_cast<long long>(accounts);
+        long long cents = 0;
+        // Fenwick descent: the longest prefix of buckets holding no more than `accounts` accounts
+        for (size_t step = size_t(1) << highestBit(kBuckets); step > 0; step >>= 1) {
+            if (position + step <= kBuckets && counts[position + step] <= remaining) {
+                position += step;
+                remaining -= counts[position];
+                cents += sums[position];
+            }
+        }
+        double total = cents / 100.0;
+        if (remaining > 0 && position < kBuckets) {
+            long long bucketCount = prefixCount(position + 1) - prefixCount(position);
+            long long bucketCents = prefixSum(position + 1) - prefixSum(position);
+            total += double(bucketCents) / double(bucketCount) * double(remaining) / 100.0;
+        }
+        return total;
+    }
+
+    size_t memoryBytes() const {
+        return sizeof(counts) + sizeof(sums);
+    }
+
+private:
+    static long long toCents(double balance) {
+        return std::llround(std::max(0.0, balance) * 100);
+    }
+
+    void apply(double balance, int delta) {
+        long long cents = toCents(balance);
+        for (size_t i = LatencyHistogram::bucketIndex(static_cast<unsigned long long>(cents)) + 1; i <= kBuckets; i += i & (~i + 1)) {
+            counts[i] += delta;
+            sums[i] += delta * cents;
+        }
+    }
+
+    // Accounts in the first `buckets` buckets
+    long long prefixCount(size_t buckets) const {
+        long long total = 0;
+        for (size_t i = buckets; i > 0; i -= i & (~i + 1)) {
+            total += counts[i];
+        }
+        return total;
+    }
+
+    // Cents in the first `buckets` buckets
+    long long prefixSum(size_t buckets) const {
+        long long total = 0;
+        for (size_t i = buckets; i > 0; i -= i & (~i + 1)) {
+            total += sums[i];
+        }
+        return total;
+    }
+
+    std::array<long long, kBuckets + 1> counts{}; // 1-based Fenwick arrays
+    std::array<long long, kBuckets + 1> sums{};
+};
+
+// One strategy's row of the grouped report
+struct StrategySummary {
+    std::string label;
+    size_t count = 0;
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+    std::vector<size_t> histogram; // Accounts per decade of balance: [0, 1), [1, 10), [10, 100), ...
+};
+
+// Count, sum and balance histograms per deposit strategy, maintained on every balance change so the
+// grouped report costs nothing to read. Sums are kept in cents so they stay exact; the fine histogram
+// (LatencyHistogram buckets) locates each group's smallest and largest balance. Not thread-safe; the
+// bank serializes access.
+class StrategyAggregates {
+public:
+    static constexpr int kDecades = 14; // The last decade is open-ended
+
+    // Group number for a strategy label, creating the group on first use
+    int groupOf(const std::string& label) {
+        for (size_t i = 0; i < groups.size(); ++i) {
+            if (groups[i]->label == label) {
+                return static_cast<int>(i);
+            }
+        }
+        groups.push_back(std::make_unique<Group>());
+        groups.back()->label = label;
+        return static_cast<int>(groups.size() - 1);
+    }
+
+    // Group number for a strategy label, or -1 if no account has used it
+    int findGroup(const std::string& label) const {
+        for (size_t i = 0; i < groups.size(); ++i) {
+            if (groups[i]->label == label) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void add(int group, double balance) {
+        apply(*groups[group], balance, 1);
+    }
+
+    void update(int group, double before, double after) {
+        if (before != after) {
+            apply(*groups[group], before, -1);
+            apply(*groups[group], after, 1);
+        }
+    }
+
+    size_t groupCount() const {
+        return groups.size();
+    }
+
+    const std::string& label(int group) const {
+        return groups[group]->label;
+    }
+
+    // Fills in everything but min and max
+    StrategySummary summary(int group) const {
+        const Group& g = *groups[group];
+        StrategySummary result;
+        result.label = g.label;
+        result.count = static_cast<size_t>(g.count);
+        result.sum = g.cents / 100.0;
+        result.histogram.assign(g.decades.begin(), g.decades.end());
+        return result;
+    }
+
+    // Balance range, in currency units, of the group's lowest (or highest) non-empty fine bucket
+    bool extremeBucket(int group, bool highest, double& low, double& high) const {
+        const Group& g = *groups[group];
+        if (g.count == 0) {
+            return false;
+        }
+        int bucket = 0;
+        if (highest) {
+            for (bucket = LatencyHistogram::kBucketCount - 1; g.buckets[bucket] == 0; --bucket) {
+            }
+        }
+        else {
+            for (bucket = 0; g.buckets[bucket] == 0; ++bucket) {
+            }
+        }
+        unsigned long long lowCents = bucket == 0 ? 0 : LatencyHistogram::bucketUpperBound(bucket - 1) + 1;
+        unsigned long long highCents = LatencyHistogram::bucketUpperBound(bucket);
+        // Balances are rounded to cents when bucketed, so widen by half a cent on each side
+        low = (double(lowCents) - 0.5) / 100;
+        high = (double(highCents) + 0.5) / 100;
+        return true;
+    }
+
+    size_t memoryBytes() const {
+        return groups.size() * sizeof(Group);
+    }
+
+private:
+    struct Group {
+        std::string label;
+        long long count = 0;
+        long long cents = 0;
+        std::array<long long, LatencyHistogram::kBucketCount> buckets{};
+        std::array<long long, kDecades> decades{};
+    };
+
+    static int decadeOf(double balance) {
+        int decade = 0;
+        for (double bound = 1; decade < kDecades - 1 && balance >= bound; bound *= 10) {
+            ++decade;
+        }
+        return decade;
+    }
+
+    static void apply(Group& g, double balance, int delta) {
+        long long cents = std::llround(std::max(0.0, balance) * 100);
+        g.count += delta;
+        g.cents += delta * cents;
+        g.buckets[LatencyHistogram::bucketIndex(static_cast<unsigned long long>(cents))] += delta;
+        g.decades[decadeOf(balance)] += delta;
+    }
+
+    std::vector<std::unique_ptr<Group>> groups;
+};
+
+// Function to print the per-strategy report
+void printStrategySummaries(const std::vector<StrategySummary>& summaries, std::ostream& os) {
+    if (summaries.empty()) {
+        os << "No depositors were added.\n";
+        return;
+    }
+    for (const auto& s : summaries) {
+        os << "Strategy: " << s.label << ", Accounts: " << s.count << ", Sum: " << s.sum
+            << ", Min: " << s.min << ", Max: " << s.max << "\n";
+        double bound = 1;
+        for (size_t d = 0; d < s.histogram.size(); ++d, bound *= 10) {
+            if (s.histogram[d] == 0) {
+                continue;
+            }
+            os << "  " << (d == 0 ? 0 : bound / 10) << " - ";
+            if (d + 1 < s.histogram.size()) {
+                os << bound;
+            }
+            else {
+                os << "...";
+            }
+            os << ": " << s.histogram[d] << "\n";
+        }
+    }
+}
+
+// Compressed bitmap of account slots in the style of Roaring: values are split by their high 16 bits
+// into containers, each holding its low 16 bits either as a sorted array (up to kArrayMaximum values,
+// 2 bytes each) or as a 65536-bit bitset (8 KB), whichever is smaller. Intersections work container by
+// container, word by word for two bitsets. Run-length containers are not implemented.
+class RoaringBitmap {
+public:
+    static constexpr size_t kArrayMaximum = 4096;
+    static constexpr size_t kBitsetWords = 65536 / 64;
+
+    void add(unsigned int value) {
+        Container& c = containerFor(static_cast<unsigned short>(value >> 16));
+        unsigned short low = static_cast<unsigned short>(value & 0xFFFF);
+        if (c.isBitset()) {
+            unsigned long long& word = c.bits[low >> 6];
+            unsigned long long bit = 1ULL << (low & 63);
+            c.cardinality += (word & bit) == 0;
+            word |= bit;
+            return;
+        }
+        // Slots are usually added in increasing order, so check the end first
+        auto position = !c.values.empty() && c.values.back() < low ? c.values.end()
+            : std::lower_bound(c.values.begin(), c.values.end(), low);
+        if (position != c.values.end() && *position == low) {
+            return;
+        }
+        c.values.insert(position, low);
+        ++c.cardinality;
+        if (c.cardinality > kArrayMaximum) {
+            c.toBitset();
+        }
+    }
+
+    void remove(unsigned int value) {
+        auto it = findContainer(static_cast<unsigned short>(value >> 16));
+        if (it == containers.end()) {
+            return;
+        }
+        Container& c = *it;
+        unsigned short low = static_cast<unsigned short>(value & 0xFFFF);
+        if (c.isBitset()) {
+            unsigned long long& word = c.bits[low >> 6];
+            unsigned long long bit = 1ULL << (low & 63);
+            c.cardinality -= (word & bit) != 0;
+            word &= ~bit;
+            if (c.cardinality <= kArrayMaximum) {
+                c.toArray();
+            }
+        }
+        else {
+            auto position = std::lower_bound(c.values.begin(), c.values.end(), low);
+            if (position != c.values.end() && *position == low) {
+                c.values.erase(position);
+                --c.cardinality;
+            }
+        }
+        if (c.cardinality == 0) {
+            containers.erase(it);
+        }
+    }
+
+    bool contains(unsigned int value) const {
+        auto it = std::lower_bound(containers.begin(), containers.end(), static_cast<unsigned short>(value >> 16),
+            [](const Container& c, unsigned short k) { return c.key < k; });
+        if (it == containers.end() || it->key != (value >> 16)) {
+            return false;
+        }
+        unsigned short low = static_cast<unsigned short>(value & 0xFFFF);
+        if (it->isBitset()) {
+            return (it->bits[low >> 6] >> (low & 63)) & 1;
+        }
+        return std::binary_search(it->values.begin(), it->values.end(), low);
+    }
+
+    size_t cardinality() const {
+        size_t total = 0;
+        for (const auto& c : containers) {
+            total += c.cardinality;
+        }
+        return total;
+    }
+
+    // Values present in both bitmaps
+    static RoaringBitmap intersect(const RoaringBitmap& a, const RoaringBitmap& b) {
+        RoaringBitmap result;
+        auto i = a.containers.begin();
+        auto j = b.containers.begin();
+        while (i != a.containers.end() && j != b.containers.end()) {
+            if (i->key < j->key) {
+                ++i;
+            }
+            else if (j->key < i->key) {
+                ++j;
+            }
+            else {
+                Container c = intersect(*i, *j);
+                if (c.cardinality > 0) {
+                    result.containers.push_back(std::move(c));
+                }
+                ++i;
+                ++j;
+            }
+        }
+        return result;
+    }
+
+    // Calls visit(value) for every value in increasing order
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (const auto& c : containers) {
+            unsigned int high = static_cast<unsigned int>(c.key) << 16;
+            if (c.isBitset()) {
+                for (size_t w = 0; w < kBitsetWords; ++w) {
+                    for (unsigned long long word = c.bits[w]; word != 0; word &= word - 1) {
+                        visit(high | static_cast<unsigned int>(w * 64 + lowestBit(word)));
+                    }
+                }
+            }
+            else {
+                for (unsigned short low : c.values) {
+                    visit(high | low);
+                }
+            }
+        }
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = containers.capacity() * sizeof(Container);
+        for (const auto& c : containers) {
+            bytes += c.values.capacity() * sizeof(unsigned short) + c.bits.capacity() * sizeof(unsigned long long);
+        }
+        return bytes;
+    }
+
+private:
+    struct Container {
+        unsigned short key = 0;              // High 16 bits shared by the container's values
+        unsigned int cardinality = 0;
+        std::vector<unsigned short> values;  // Array form: sorted low 16 bits
+        std::vector<unsigned long long> bits; // Bitset form: kBitsetWords words, empty in array form
+
+        bool isBitset() const {
+            return !bits.empty();
+        }
+
+        void toBitset() {
+            bits.assign(kBitsetWords, 0);
+            for (unsigned short low : values) {
+                bits[low >> 6] |= 1ULL << (low & 63);
+            }
+            std::vector<unsigned short>().swap(values);
+        }
+
+        void toArray() {
+            values.reserve(cardinality);
+            for (size_t w = 0; w < kBitsetWords; ++w) {
+                for (unsigned long long word = bits[w]; word != 0; word &= word - 1) {
+                    values.push_back(static_cast<unsigned short>(w * 64 + lowestBit(word)));
+                }
+            }
+            std::vector<unsigned long long>().swap(bits);
+        }
+    };
+
+    static Container intersect(const Container& a, const Container& b) {
+        Container result;
+        result.key = a.key;
+        if (a.isBitset() && b.isBitset()) {
+            result.bits.resize(kBitsetWords);
+            for (size_t w = 0; w < kBitsetWords; ++w) {
+                result.bits[w] = a.bits[w] & b.bits[w];
+                result.cardinality += static_cast<size_t>(popCount(result.bits[w]));
+            }
+            if (result.cardinality <= kArrayMaximum) {
+                result.toArray();
+            }
+        }
+        else if (a.isBitset() || b.isBitset()) {
+            const Container& array = a.isBitset() ? b : a;
+            const Container& bitset = a.isBitset() ? a : b;
+            for (unsigned short low : array.values) {
+                if ((bitset.bits[low >> 6] >> (low & 63)) & 1) {
+                    result.values.push_back(low);
+                }
+            }
+            result.cardinality = result.values.size();
+        }
+        else {
+            std::set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                std::back_inserter(result.values));
+            result.cardinality = result.values.size();
+        }
+        return result;
+    }
+
+    std::vector<Container>::iterator findContainer(unsigned short key) {
+        auto it = std::lower_bound(containers.begin(), containers.end(), key,
+            [](const Container& c, unsigned short k) { return c.key < k; });
+        return it != containers.end() && it->key == key ? it : containers.end();
+    }
+
+    Container& containerFor(unsigned short key) {
+        if (!containers.empty() && containers.back().key == key) {
+            return containers.back();
+        }
+        auto it = std::lower_bound(containers.begin(), containers.end(), key,
+            [](const Container& c, unsigned short k) { return c.key < k; });
+        if (it == containers.end() || it->key != key) {
+            it = containers.insert(it, Container());
+            it->key = key;
+        }
+        return *it;
+    }
+
+    std::vector<Container> containers; // Sorted by key
+};
+
+// Name search index. Lowercased names are appended to one arena in slot order. Prefix search binary
+// searches a slot list sorted by name; names added since the last search wait in a pending tail and
+// are sorted and merged in on the next search, so adding stays O(1). Substring search intersects the
+// RoaringBitmaps of the pattern's letter trigrams and verifies the candidates; patterns shorter than
+// three letters (or with other characters) fall back to scanning the arena.
+// Not thread-safe; the bank serializes access.
+class NameIndex {
+public:
+    static constexpr int kTrigrams = 26 * 26 * 26;
+    static constexpr int kLongName = 31;               // Name lengths are stored in 5 bits
+    static constexpr unsigned int kLetterMask = (1u << 27) - 1;
+
+    NameIndex() : trigrams(kTrigrams) {}
+
+    // Slots must be added in increasing order without gaps
+    void add(size_t slot, const std::string& name) {
+        unsigned int offset = static_cast<unsigned int>(arena.size());
+        for (char c : name) {
+            arena.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        }
+        spans.push_back({ offset, static_cast<unsigned int>(name.size()) });
+        std::string_view lower = nameOf(slot);
+        filters.push_back(letterSetOf(lower) | static_cast<unsigned int>(std::min<size_t>(lower.size(), kLongName)) << 27);
+        for (size_t i = 0; i + 3 <= lower.size(); ++i) {
+            int trigram = trigramOf(lower.substr(i, 3));
+            if (trigram >= 0) {
+                trigrams[trigram].add(static_cast<unsigned int>(slot));
+            }
+        }
+    }
+
+    // Calls visit(slot) for names starting with the prefix (case-insensitive) in name order, until
+    // visit returns false
+    template <typename Visit>
+    void forEachWithPrefix(const std::string& prefix, Visit visit) {
+        mergePending();
+        std::string lower = toLower(prefix);
+        auto first = std::lower_bound(sorted.begin(), sorted.end(), lower,
+            [&](unsigned int slot, const std::string& p) { return nameOf(slot) < p; });
+        for (auto it = first; it != sorted.end() && nameOf(*it).substr(0, lower.size()) == lower; ++it) {
+            if (!visit(*it)) {
+                return;
+            }
+        }
+    }
+
+    // Calls visit(slot) for names containing the text (case-insensitive) in slot order, until visit
+    // returns false
+    template <typename Visit>
+    void forEachContaining(const std::string& text, Visit visit) const {
+        std::string lower = toLower(text);
+        std::vector<const RoaringBitmap*> lists;
+        for (size_t i = 0; i + 3 <= lower.size(); ++i) {
+            int trigram = trigramOf(std::string_view(lower).substr(i, 3));
+            if (trigram < 0) {
+                lists.clear();
+                break;
+            }
+            lists.push_back(&trigrams[trigram]);
+        }
+        if (lists.empty()) {
+            for (size_t slot = 0; slot < spans.size(); ++slot) {
+                if (nameOf(slot).find(lower) != std::string_view::npos && !visit(slot)) {
+                    return;
+                }
+            }
+            return;
+        }
+
+        std::sort(lists.begin(), lists.end(),
+            [](const RoaringBitmap* a, const RoaringBitmap* b) { return a->cardinality() < b->cardinality(); });
+        RoaringBitmap intersection;
+        const RoaringBitmap* candidates = lists[0];
+        for (size_t i = 1; i < lists.size() && candidates->cardinality() > 0; ++i) {
+            intersection = RoaringBitmap::intersect(*candidates, *lists[i]);
+            candidates = &intersection;
+        }
+        // Trigrams only narrow the candidates; each one is checked against the full pattern
+        bool more = true;
+        candidates->forEach([&](unsigned int slot) {
+            if (more && nameOf(slot).find(lower) != std::string_view::npos) {
+                more = visit(slot);
+            }
+        });
+    }
+
+    // Calls visit(slot, distance) for every name within maxDistance edits of the text (case-insensitive),
+    // scanning the arena on up to `threads` threads; visit is called from the calling thread only
+    template <typename Visit>
+    void forEachSimilar(const std::string& text, int maxDistance, unsigned threads, Visit visit) const {
+        std::string pattern = toLower(text);
+        if (pattern.size() > 64) {
+            throw InvalidInputException("Fuzzy search text is limited to 64 characters");
+        }
+        // Positions of each character in the pattern, one bit per position
+        std::array<unsigned long long, 256> positions{};
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            positions[static_cast<unsigned char>(pattern[i])] |= 1ULL << i;
+        }
+
+        unsigned int patternLetters = letterSetOf(pattern);
+        size_t count = spans.size();
+        threads = count < 65536 ? 1 : std::max(1u, threads);
+        std::vector<std::vector<std::pair<size_t, int>>> found(threads);
+        auto scan = [&](unsigned part) {
+            for (size_t slot = count * part / threads, end = count * (part + 1) / threads; slot < end; ++slot) {
+                // Lengths alone already differ by more than the allowed edits (names of kLongName
+                // characters or more are only checked against the full length below)
+                unsigned int filter = filters[slot];
+                int length = static_cast<int>(filter >> 27);
+                if (length < kLongName && std::abs(length - static_cast<int>(pattern.size())) > maxDistance) {
+                    continue;
+                }
+                // Each edit adds or removes at most one distinct letter, so letters found in only one
+                // of the two words bound the distance from below
+                unsigned int letters = filter & kLetterMask;
+                if (hasMoreBitsThan(patternLetters & ~letters, maxDistance) || hasMoreBitsThan(letters & ~patternLetters, maxDistance)) {
+                    continue;
+                }
+                std::string_view name = nameOf(slot);
+                if (std::abs(static_cast<int>(name.size()) - static_cast<int>(pattern.size())) > maxDistance) {
+                    continue;
+                }
+                int distance = boundedEditDistance(positions, static_cast<int>(pattern.size()), name, maxDistance);
+                if (distance <= maxDistance) {
+                    found[part].push_back({ slot, distance });
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned part = 1; part < threads; ++part) {
+            workers.emplace_back(scan, part);
+        }
+        scan(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (const auto& part : found) {
+            for (const auto& match : part) {
+                visit(match.first, match.second);
+            }
+        }
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = arena.capacity() + spans.capacity() * sizeof(Span) + sorted.capacity() * sizeof(unsigned int)
+            + filters.capacity() * sizeof(unsigned int)
+            + trigrams.capacity() * sizeof(RoaringBitmap);
+        for (const auto& bitmap : trigrams) {
+            bytes += bitmap.memoryBytes();
+        }
+        return bytes;
+    }
+
+private:
+    struct Span {
+        unsigned int offset;
+        unsigned int length;
+    };
+
+    static std::string toLower(const std::string& text) {
+        std::string lower(text);
+        for (char& c : lower) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return lower;
+    }
+
+    // Edit distance between a pattern of up to 64 characters and a text, with Myers' bit-parallel
+    // algorithm in Hyyro's formulation: one 64-bit word holds a whole column of the dynamic programming
+    // table as vertical +1/-1 deltas, so each text character costs a handful of word operations. The top
+    // row grows by one per text character, which makes this the global (whole-name) distance. Gives up
+    // and returns maxDistance + 1 as soon as the remaining characters cannot bring it back in range.
+    static int boundedEditDistance(const std::array<unsigned long long, 256>& positions, int patternLength,
+        std::string_view text, int maxDistance) {
+        int textLength = static_cast<int>(text.size());
+        if (patternLength == 0) {
+            return textLength;
+        }
+        unsigned long long plus = ~0ULL;  // Vertical deltas of +1
+        unsigned long long minus = 0;     // Vertical deltas of -1
+        unsigned long long lastRow = 1ULL << (patternLength - 1);
+        int score = patternLength;
+        for (int j = 0; j < textLength; ++j) {
+            unsigned long long equal = positions[static_cast<unsigned char>(text[j])];
+            unsigned long long xv = equal | minus;
+            unsigned long long xh = (((equal & plus) + plus) ^ plus) | equal;
+            unsigned long long horizontalPlus = minus | ~(xh | plus);
+            unsigned long long horizontalMinus = plus & xh;
+            if (horizontalPlus & lastRow) {
+                ++score;
+            }
+            else if (horizontalMinus & lastRow) {
+                --score;
+            }
+            horizontalPlus = (horizontalPlus << 1) | 1;
+            horizontalMinus <<= 1;
+            plus = horizontalMinus | ~(xv | horizontalPlus);
+            minus = horizontalPlus & xv;
+            // Each remaining text character can lower the final distance by at most one
+            if (score - (textLength - j - 1) > maxDistance) {
+                return maxDistance + 1;
+            }
+        }
+        return score;
+    }
+
+    // Whether more than limit bits are set; clears the lowest set bit limit times, which for the small
+    // limits of a fuzzy search is cheaper than a full population count
+    static bool hasMoreBitsThan(unsigned int value, int limit) {
+        for (int i = 0; i < limit && value != 0; ++i) {
+            value &= value - 1;
+        }
+        return value != 0;
+    }
+
+    // Bit i is set if the text contains letter 'a' + i; other characters share bit 26
+    static unsigned int letterSetOf(std::string_view text) {
+        unsigned int letters = 0;
+        for (char c : text) {
+            letters |= c >= 'a' && c <= 'z' ? 1u << (c - 'a') : 1u << 26;
+        }
+        return letters;
+    }
+
+    // Index of a lowercase letter trigram, or -1 if it has another character
+    static int trigramOf(std::string_view three) {
+        int trigram = 0;
+        for (char c : three) {
+            if (c < 'a' || c > 'z') {
+                return -1;
+            }
+            trigram = trigram * 26 + (c - 'a');
+        }
+        return trigram;
+    }
+
+    std::string_view nameOf(size_t slot) const {
+        return std::string_view(arena.data() + spans[slot].offset, spans[slot].length);
+    }
+
+    // Sorts the names added since the last search and merges them into the sorted list
+    void mergePending() {
+        size_t merged = sorted.size();
+        if (merged == spans.size()) {
+            return;
+        }
+        auto byName = [&](unsigned int a, unsigned int b) {
+            return nameOf(a) < nameOf(b) || (nameOf(a) == nameOf(b) && a < b);
+        };
+        // Sort on the first eight bytes packed into an integer, which orders most names without
+        // touching the arena; only names sharing those bytes are compared in full
+        std::vector<std::pair<unsigned long long, unsigned int>> pending;
+        pending.reserve(spans.size() - merged);
+        for (size_t slot = merged; slot < spans.size(); ++slot) {
+            std::string_view name = nameOf(slot);
+            unsigned long long key = 0;
+            for (size_t i = 0; i < 8; ++i) {
+                key = (key << 8) | (i < name.size() ? static_cast<unsigned char>(name[i]) : 0);
+            }
+            pending.push_back({ key, static_cast<unsigned int>(slot) });
+        }
+        std::sort(pending.begin(), pending.end(), [&](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first < b.first : byName(a.second, b.second);
+        });
+        for (const auto& entry : pending) {
+            sorted.push_back(entry.second);
+        }
+        std::inplace_merge(sorted.begin(), sorted.begin() + merged, sorted.end(), byName);
+    }
+
+    std::string arena;                  // Lowercased names back to back, in slot order
+    std::vector<Span> spans;            // Arena position of each slot's name
+    std::vector<unsigned int> filters;  // Per slot: letterSetOf(name) in bits 0-26, min(length, kLongName) above
+    std::vector<unsigned int> sorted;   // Slots ordered by name; shorter than spans while names are pending
+    std::vector<RoaringBitmap> trigrams; // Slots whose name contains each letter trigram
+};
+
+// One result of a fuzzy name search
+struct NameMatch {
+    std::string id;
+    std::string name;
+    int distance; // Edits (insertions, deletions, substitutions) between the name and the search text
+};
+
+// Function to print fuzzy search results
+void printNameMatches(const std::vector<NameMatch>& matches, std::ostream& os) {
+    if (matches.empty()) {
+        os << "No similar names found.\n";
+        return;
+    }
+    for (const auto& match : matches) {
+        os << "Did you mean: " << match.name << " (Depositor ID: " << match.id << ", " << match.distance
+            << (match.distance == 1 ? " edit)" : " edits)") << "\n";
+    }
+}
+
+// Result of a bitmap filter query
+struct FilterResult {
+    size_t count = 0;
+    double total = 0; // Sum of stored balances of the matching accounts
+};
+
+// Result of a batch of deposits
+struct DepositBatchResult {
+    size_t applied = 0;
+    size_t rejected = 0;        // Invalid amounts and deposits past a strategy's limits
+    size_t unknownAccounts = 0;
+    double credited = 0;        // Sum credited, strategy bonuses included
+};
+
+// Result of an interest accrual pass
+struct AccrualResult {
+    size_t accounts = 0;      // Accounts whose balance changed
+    double credited = 0;      // Net interest paid (negative when fees outweigh it)
+    double seconds = 0;       // Time spent applying interest to the balances
+    double indexSeconds = 0;  // Time spent moving changed accounts in the balance indexes
+};
+
+// One row of a ranking query
+struct RankedDepositor {
+    std::string id;
+    std::string name;
+    double balance;
+};
+
+// Function to print a ranking, one depositor per line
+void printRanking(const std::vector<RankedDepositor>& ranking, std::ostream& os) {
+    if (ranking.empty()) {
+        os << "No depositors were added.\n";
+        return;
+    }
+    for (size_t i = 0; i < ranking.size(); ++i) {
+        os << (i + 1) << ". Depositor ID: " << ranking[i].id << ", Name: " << ranking[i].name
+            << ", Balance: " << ranking[i].balance << "\n";
+    }
+}
+
+// Mutex that records how often and for how long callers had to wait for it
+class InstrumentedMutex {
+public:
+    void lock() {
+        if (!mutex.try_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            mutex.lock();
+            auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            // Updated while holding the mutex, so plain load/store pairs are enough
+            contended.store(contended.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            waitNs.store(waitNs.load(std::memory_order_relaxed) + waited.count(), std::memory_order_relaxed);
+        }
+        acquisitions.store(acquisitions.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    bool try_lock() {
+        if (!mutex.try_lock()) {
+            return false;
+        }
+        acquisitions.store(acquisitions.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void unlock() {
+        mutex.unlock();
+    }
+
+    unsigned long long acquisitionCount() const {
+        return acquisitions.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long contendedCount() const {
+        return contended.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long waitNanoseconds() const {
+        return waitNs.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex mutex;
+    std::atomic<unsigned long long> acquisitions{ 0 };
+    std::atomic<unsigned long long> contended{ 0 };
+    std::atomic<unsigned long long> waitNs{ 0 };
+};
+
+// Contention totals for one lock (or a group of lock stripes) of a Bank
+struct LockStats {
+    std::string name;
+    unsigned long long acquisitions;
+    unsigned long long contended;
+    double waitSeconds;
+};
+
+// How a Bank synchronizes concurrent callers
+enum class ConcurrencyMode {
+    GlobalLock, // One mutex serializes every operation
+    Sharded,    // Adds are serialized; an account update locks the account's stripe
+    LockFree    // Adds are serialized; account updates use compare-and-swap, and take the account's stripe
+                // only while history or the balance index is kept (see Bank::stripedUpdates)
+};
+
+const char* concurrencyModeName(ConcurrencyMode mode) {
+    switch (mode) {
+    case ConcurrencyMode::GlobalLock: return "global-lock";
+    case ConcurrencyMode::Sharded: return "sharded";
+    default: return "lock-free";
+    }
+}
+
+// Bytes held by a Bank, broken down by structure
+struct MemoryFootprint {
+    size_t records = 0; // Depositor records, including reserved but unused slots
+    size_t names = 0;   // Heap storage of names and IDs that do not fit inline
+    size_t indexes = 0; // Lookup structures
+    size_t history = 0; // Transaction history
+    size_t fixed = 0;   // Per-bank overhead independent of the number of accounts (locks, metrics)
+
+    size_t total() const {
+        return records + names + indexes + history + fixed;
+    }
+};
+
+// Construction options of a Bank
+struct BankOptions {
+    ConcurrencyMode concurrency = ConcurrencyMode::GlobalLock;
+    bool printMessages = true; // Print confirmations and deposit errors to the output streams
+    bool recordHistory = true; // Keep every balance change in the transaction log
+    unsigned int checkpointInterval = 32; // Transactions per account between point-in-time checkpoints
+    bool indexBalances = true; // Keep the secondary indexes used by ranking, report and filter queries
+    bool enforceDepositLimits = true; // Count deposits toward the strategies' daily and monthly limits
+    std::shared_ptr<Clock> clock;         // Defaults to the system clock
+    std::shared_ptr<RandomSource> random; // Used for depositor IDs; defaults to a randomly seeded generator
+};
+
+// Set by --deterministic: banks created by the program use a simulated clock and a fixed seed
+bool deterministicRun = false;
+unsigned long long deterministicSeed = 1;
+
+// Function to build the options for a bank created by one of the program's modes
+BankOptions makeBankOptions() {
+    BankOptions options;
+    if (deterministicRun) {
+        options.clock = std::make_shared<SimulatedClock>();
+        options.random = std::make_shared<MersenneRandom>(deterministicSeed);
+    }
+    return options;
+}
+
+// Bank class to manage depositors and calculate total deposits
+class Bank {
+public:
+    static constexpr size_t kShards = 64;
+    static constexpr unsigned kMaxInterestPeriods = 10000;
+    static constexpr double kMaxInterestCents = 9007199254740992.0; // 2^53: above it doubles skip whole cents
+
+private:
+    // Balance change not yet applied to the balance-ordered indexes
+    struct BalanceChange {
+        size_t slot;
+        double before;
+        double after;
+    };
+
+    // Lock stripe on its own cache line so neighbouring stripes do not false-share. Updates queue their
+    // index changes on the stripe, under the stripe lock they already hold, instead of taking indexMutex.
+    struct alignas(64) Shard {
+        InstrumentedMutex mutex;
+        std::vector<BalanceChange> pendingIndex;
+    };
+
+    // Queued changes at which a stripe tries to apply them: one update in this many pays for the others,
+    // which shows at p99.9 rather than p99
+    static constexpr size_t kPendingIndexLimit = 256;
+
+    StableVector<Depositor> depositors; // Slot order is insertion order
+    IdIndex idIndex;
+    TransactionLog transactionLog;
+    // Balance-ordered indexes. Queries apply the stripes' queued changes first (see applyPendingIndex),
+    // which brings them up to date without changing what they describe.
+    mutable BalanceIndex balanceIndex;
+    mutable BalanceDistribution balanceDistribution;
+    mutable StrategyAggregates strategyAggregates;
+    std::vector<RoaringBitmap> strategyBitmaps;           // Accounts per strategy group
+    std::vector<std::pair<std::string, RoaringBitmap>> tagBitmaps; // Accounts per tag, in creation order
+    mutable NameIndex nameIndex; // Searches merge pending names in, which does not change what the index holds
+    std::ostream& out; // Stream for regular messages
+    std::ostream& err; // Stream for error messages
+    BankOptions options;
+    mutable BankMetrics bankMetrics;
+    mutable InstrumentedMutex globalMutex; // GlobalLock mode: held by every operation
+    InstrumentedMutex addMutex;            // Other modes: serializes account creation
+    mutable std::array<Shard, kShards> shards;
+    mutable InstrumentedMutex outputMutex; // Other modes: keeps concurrent messages from interleaving
+    mutable InstrumentedMutex indexMutex;  // Other modes: guards the indexes; updates only try it (see reindexBalance)
+
+    using Lock = std::unique_lock<InstrumentedMutex>;
+
+    bool concurrent() const {
+        return options.concurrency != ConcurrencyMode::GlobalLock;
+    }
+
+    Lock lockGlobal() const {
+        return concurrent() ? Lock() : Lock(globalMutex);
+    }
+
+    // Whether a single-account update takes the account's stripe: always in sharded mode, and in lock-free
+    // mode while history or the balance index is kept, since a balance change and what is derived from it
+    // must be applied in the same order
+    bool stripedUpdates() const {
+        return options.concurrency == ConcurrencyMode::Sharded ||
+            (options.concurrency == ConcurrencyMode::LockFree && (options.recordHistory || options.indexBalances));
+    }
+
+    Lock lockAccount(size_t slot) const {
+        return stripedUpdates() ? Lock(shards[slot % kShards].mutex) : Lock();
+    }
+
+    // Limits a deposit to the account must respect (none while enforceDepositLimits is off)
+    DepositLimits depositLimitsFor(size_t slot) const {
+        return options.enforceDepositLimits ? depositors[slot].depositLimits() : DepositLimits();
+    }
+
+    // Lock for a deposit: the account's stripe as for any update, and in lock-free mode also whenever
+    // the strategy has limits, since the deposit windows are read and written together
+    Lock lockForDeposit(size_t slot, const DepositLimits& limits) const {
+        return stripedUpdates() || (concurrent() && limits.any()) ? Lock(shards[slot % kShards].mutex) : Lock();
+    }
+
+    // Appends a balance change to the account's history; callers hold the account's update lock
+    void recordTransaction(size_t slot, TransactionKind kind, double change, long long timestampNs) {
+        if (!options.recordHistory) {
+            return;
+        }
+        Depositor& depositor = depositors[slot];
+        unsigned long long previous = depositor.lastTransactionReference();
+        unsigned int sequence = previous ? transactionLog.at(previous).sequence + 1 : 1;
+        Transaction transaction{ timestampNs, change, depositor.balance(), previous, sequence, kind };
+        unsigned long long reference = transactionLog.append(transaction);
+        if (sequence % options.checkpointInterval == 0) {
+            depositor.addCheckpoint(timestampNs, reference);
+        }
+        depositor.setLastTransactionReference(reference);
+    }
+
+    Lock lockIndex() const {
+        return concurrent() ? Lock(indexMutex) : Lock();
+    }
+
+    // Moves the account in the balance index, distribution and strategy aggregates; callers hold the
+    // index lock
+    void applyBalanceChange(const BalanceChange& change) const {
+        balanceIndex.update(change.before, change.after, change.slot);
+        balanceDistribution.update(change.before, change.after);
+        strategyAggregates.update(depositors[change.slot].getStrategyGroup(), change.before, change.after);
+    }
+
+    // Applies the changes queued on one stripe; callers hold the stripe and the index lock
+    void applyQueuedChanges(Shard& shard) const {
+        for (const auto& change : shard.pendingIndex) {
+            applyBalanceChange(change);
+        }
+        shard.pendingIndex.clear();
+    }
+
+    // Brings the balance-ordered indexes up to date before a query reads them; callers hold the index
+    // lock. Each stripe's queue is swapped out under its lock and applied after, so updates to the
+    // stripe wait only for the swap. An account's changes are all queued on its own stripe, in order.
+    void applyPendingIndex() const {
+        if (!concurrent() || !options.indexBalances) {
+            return; // GlobalLock mode applies every change at once
+        }
+        std::vector<BalanceChange> changes;
+        for (auto& shard : shards) {
+            {
+                Lock account(shard.mutex);
+                changes.swap(shard.pendingIndex);
+            }
+            for (const auto& change : changes) {
+                applyBalanceChange(change);
+            }
+            changes.clear();
+        }
+    }
+
+    // Records that the account's balance moved from before to its current balance; callers hold the
+    // account's update lock. In the concurrent modes the change is queued on the account's stripe, so
+    // updates to different stripes never meet on the index lock; a stripe whose queue has grown long
+    // applies it itself, but only if the index lock is free at that moment, so an update never waits for
+    // a query (queries take the index lock and then the stripes).
+    void reindexBalance(size_t slot, double before) {
+        if (!options.indexBalances) {
+            return;
+        }
+        BalanceChange change{ slot, before, depositors[slot].balance() };
+        if (!concurrent()) {
+            applyBalanceChange(change);
+            return;
+        }
+        Shard& shard = shards[slot % kShards];
+        shard.pendingIndex.push_back(change);
+        if (shard.pendingIndex.size() >= kPendingIndexLimit) {
+            Lock index(indexMutex, std::try_to_lock);
+            if (index.owns_lock()) {
+                applyQueuedChanges(shard);
+            }
+        }
+    }
+
+    // Same as reindexBalance for many accounts (slot and balance before)
+    void reindexBalances(const std::vector<std::pair<size_t, double>>& changed) {
+        for (const auto& change : changed) {
+            reindexBalance(change.first, change.second);
+        }
+    }
+
+    // Locks the stripes of both accounts of a transfer, lower stripe first, so two transfers can never
+    // wait on each other in a cycle. Lock-free mode takes them too: without a double-word CAS this is
+    // what makes the debit and credit one atomic step for other transfers.
+    std::pair<Lock, Lock> lockAccountPair(size_t first, size_t second) const {
+        if (!concurrent()) {
+            return {};
+        }
+        size_t low = std::min(first % kShards, second % kShards);
+        size_t high = std::max(first % kShards, second % kShards);
+        Lock lowLock(shards[low].mutex);
+        return { std::move(lowLock), high != low ? Lock(shards[high].mutex) : Lock() };
+    }
+
+    // Locks every stripe in order (sharded mode) so a scan sees no transfer half done
+    std::array<Lock, kShards> lockAllAccounts() const {
+        std::array<Lock, kShards> locks;
+        if (options.concurrency == ConcurrencyMode::Sharded) {
+            for (size_t i = 0; i < kShards; ++i) {
+                locks[i] = Lock(shards[i].mutex);
+            }
+        }
+        return locks;
+    }
+
+    Lock lockOutput() const {
+        return concurrent() ? Lock(outputMutex) : Lock();
+    }
+
+    template <typename... Parts>
+    void message(std::ostream& os, const Parts&... parts) const {
+        if (options.printMessages) {
+            Lock lock = lockOutput();
+            (os << ... << parts);
+        }
+    }
+
+    long long findSlot(const std::string& depositorID) const {
+        return idIndex.find(depositorID, [&](size_t slot) { return depositors[slot].hasID(depositorID); });
+    }
+
+public:
+    explicit Bank(std::ostream& out = std::cout, std::ostream& err = std::cerr, BankOptions options = BankOptions())
+        : out(out), err(err), options(options) {
+        if (!this->options.clock) {
+            this->options.clock = std::make_shared<SystemClock>();
+        }
+        if (!this->options.random) {
+            this->options.random = std::make_shared<MersenneRandom>();
+        }
+        this->options.checkpointInterval = std::max(1u, this->options.checkpointInterval);
+    }
+
+    // Current time of the bank's clock, in nanoseconds since the Unix epoch
+    long long now() const {
+        return options.clock->nowNs();
+    }
+
+    Clock& clock() const {
+        return *options.clock;
+    }
+
+    const BankMetrics& metrics() const {
+        return bankMetrics;
+    }
+
+    ConcurrencyMode concurrencyMode() const {
+        return options.concurrency;
+    }
+
+    std::string addDepositor(const std::string& name, const IDeposit* strategy) {
+        OperationScope scope(BankOperation::Add, bankMetrics);
+        Lock global = lockGlobal();
+        std::string depositorID;
+        {
+            Lock adding = concurrent() ? Lock(addMutex) : Lock();
+            if (depositors.size() >= kDepositorIDSpace) {
+                throw InvalidInputException("No depositor IDs are left");
+            }
+            do {
+                depositorID = generateRandomID(*options.random); // Generate a random ID, until it is unused
+            } while (findSlot(depositorID) >= 0);
+            size_t slot = depositors.size();
+            {
+                Lock index = lockIndex();
+                int group = strategyAggregates.groupOf(strategy->label()); // Interest rates are set per group
+                depositors.emplace_back(depositorID, name, 0, strategy, group); // Add depositor with 0 initial deposit
+                if (options.indexBalances) {
+                    balanceIndex.insert(0, slot);
+                    balanceDistribution.add(0);
+                    strategyAggregates.add(group, 0);
+                    if (strategyBitmaps.size() <= static_cast<size_t>(group)) {
+                        strategyBitmaps.resize(group + 1);
+                    }
+                    strategyBitmaps[group].add(static_cast<unsigned int>(slot));
+                    nameIndex.add(slot, name);
+                }
+            }
+            idIndex.insert(depositorID, slot, [&](size_t other) { return depositors[other].getID(); });
+        }
+        bankMetrics.accounts.fetch_add(1, std::memory_order_relaxed);
+
+        // Print the new depositor's ID immediately after adding
+        message(out, "Depositor added successfully! User ID: ", depositorID, "\n");
+        return depositorID;
+    }
+
+    size_t size() const {
+        return depositors.size();
+    }
+
+    bool depositToAccount(const std::string& depositorID, double amount) {
+        OperationScope scope(BankOperation::Deposit, bankMetrics);
+        Lock global = lockGlobal();
+        BANK_TRACE_SPAN("depositToAccount");
+        long long slot;
+        {
+            BANK_TRACE_SPAN("lookup");
+            slot = findSlot(depositorID);
+        }
+        if (slot < 0) {
+            bankMetrics.reject(BankMetrics::UnknownAccount);
+            return false; // If no depositor matches the given ID
+        }
+
+        try {
+            double credited;
+            {
+                DepositLimits limits = depositLimitsFor(static_cast<size_t>(slot));
+                Lock account = lockForDeposit(static_cast<size_t>(slot), limits);
+                double before = depositors[slot].balance();
+                long long timestamp = now();
+                credited = depositors[slot].deposit(amount, timestamp, limits); // Deposit the amount to the found account
+                recordTransaction(static_cast<size_t>(slot), TransactionKind::Deposit, credited, timestamp);
+                reindexBalance(static_cast<size_t>(slot), before);
+            }
+            bankMetrics.deposits.fetch_add(1, std::memory_order_relaxed);
+            atomicAdd(bankMetrics.totalBalance, credited);
+            BANK_TRACE_SPAN("logging");
+            message(out, "Deposit of ", amount, " made to account ID: ", depositorID, "\n");
+        }
+        catch (const InvalidInputException& e) {
+            bankMetrics.reject(BankMetrics::InvalidInput);
+            BANK_TRACE_SPAN("logging");
+            message(err, "Error: ", e.what(), "\n");
+        }
+        catch (const NegativeDepositException&) {
+            bankMetrics.reject(BankMetrics::NegativeDeposit);
+            throw;
+        }
+        return true;
+    }
+
+    // Function to make many deposits at once. Accounts are looked up first, then the deposits are sorted
+    // by lock stripe and account (keeping their order within an account) so each stripe and the index
+    // lock are taken once per stripe instead of once per deposit; each deposit is still validated and
+    // checked against its strategy's limits on its own. Rejected deposits are reported like
+    // depositToAccount does. The deposits of one stripe are made at one time, read once the stripe is
+    // locked: they share a timestamp in the history and count toward the same day and month. Latency is
+    // recorded per batch, as deposit-many.
+    DepositBatchResult depositMany(const std::vector<std::pair<std::string, double>>& deposits) {
+        OperationScope scope(BankOperation::DepositBatch, bankMetrics);
+        Lock global = lockGlobal();
+        DepositBatchResult result;
+        std::vector<std::pair<size_t, size_t>> order; // Slot and position in deposits
+        order.reserve(deposits.size());
+        for (size_t i = 0; i < deposits.size(); ++i) {
+            long long slot = findSlot(deposits[i].first);
+            if (slot < 0) {
+                bankMetrics.reject(BankMetrics::UnknownAccount);
+                ++result.unknownAccounts;
+                continue;
+            }
+            order.push_back({ static_cast<size_t>(slot), i });
+        }
+        std::stable_sort(order.begin(), order.end(), [](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) {
+            return a.first % kShards != b.first % kShards ? a.first % kShards < b.first % kShards : a.first < b.first;
+        });
+
+        std::vector<std::pair<size_t, double>> changed; // Slot and balance before its first deposit in the batch
+        for (size_t start = 0; start < order.size();) {
+            size_t end = start;
+            while (end < order.size() && order[end].first % kShards == order[start].first % kShards) {
+                ++end;
+            }
+            // Taken in every concurrent mode: one lock per stripe costs little next to the batch
+            Lock account = concurrent() ? Lock(shards[order[start].first % kShards].mutex) : Lock();
+            // Read under the stripe lock, so no single deposit to these accounts can log a later time first
+            long long timestamp = now();
+            changed.clear();
+            for (size_t i = start; i < end; ++i) {
+                size_t slot = order[i].first;
+                double amount = deposits[order[i].second].second;
+                try {
+                    double before = depositors[slot].balance();
+                    double credited = depositors[slot].deposit(amount, timestamp, depositLimitsFor(slot));
+                    recordTransaction(slot, TransactionKind::Deposit, credited, timestamp);
+                    // An account's deposits are adjacent; the index only needs its balance before the first
+                    if (changed.empty() || changed.back().first != slot) {
+                        changed.push_back({ slot, before });
+                    }
+                    result.credited += credited;
+                    ++result.applied;
+                }
+                catch (const InvalidInputException& e) {
+                    bankMetrics.reject(BankMetrics::InvalidInput);
+                    ++result.rejected;
+                    message(err, "Error: ", e.what(), " (deposit of ", amount, " to account ID: ", deposits[order[i].second].first, ")\n");
+                }
+                catch (const NegativeDepositException& e) {
+                    bankMetrics.reject(BankMetrics::NegativeDeposit);
+                    ++result.rejected;
+                    message(err, "Error: ", e.what(), " (deposit of ", amount, " to account ID: ", deposits[order[i].second].first, ")\n");
+                }
+            }
+            reindexBalances(changed);
+            start = end;
+        }
+        bankMetrics.deposits.fetch_add(result.applied, std::memory_order_relaxed);
+        atomicAdd(bankMetrics.totalBalance, result.credited);
+        message(out, "Made ", result.applied, " of ", deposits.size(), " deposits\n");
+        return result;
+    }
+
+    bool withdrawFromAccount(const std::string& depositorID, double amount) {
+        OperationScope scope(BankOperation::Withdraw, bankMetrics);
+        Lock global = lockGlobal();
+        long long slot = findSlot(depositorID);
+        if (slot < 0) {
+            bankMetrics.rejectDebit(BankMetrics::UnknownAccount);
+            return false; // If no depositor matches the given ID
+        }
+
+        try {
+            {
+                Lock account = lockAccount(static_cast<size_t>(slot));
+                double before = depositors[slot].balance();
+                depositors[slot].withdraw(amount);
+                recordTransaction(static_cast<size_t>(slot), TransactionKind::Withdrawal, -amount, now());
+                reindexBalance(static_cast<size_t>(slot), before);
+            }
+            bankMetrics.withdrawals.fetch_add(1, std::memory_order_relaxed);
+            atomicAdd(bankMetrics.totalBalance, -amount);
+            message(out, "Withdrawal of ", amount, " made from account ID: ", depositorID, "\n");
+        }
+        catch (const InvalidInputException& e) {
+            bankMetrics.rejectDebit(BankMetrics::InvalidInput);
+            message(err, "Error: ", e.what(), "\n");
+        }
+        catch (const InsufficientFundsException& e) {
+            bankMetrics.rejectDebit(BankMetrics::InsufficientFunds);
+            message(err, "Error: ", e.what(), "\n");
+        }
+        return true;
+    }
+
+    // Moves the amount between two accounts as one atomic step; returns false if either account is unknown
+    bool transferBetweenAccounts(const std::string& fromID, const std::string& toID, double amount) {
+        OperationScope scope(BankOperation::Transfer, bankMetrics);
+        Lock global = lockGlobal();
+        long long from = findSlot(fromID);
+        long long to = findSlot(toID);
+        if (from < 0 || to < 0) {
+            bankMetrics.rejectDebit(BankMetrics::UnknownAccount);
+            return false;
+        }
+
+        try {
+            if (from == to) {
+                throw InvalidInputException("Cannot transfer to the same account");
+            }
+            {
+                auto locks = lockAccountPair(static_cast<size_t>(from), static_cast<size_t>(to));
+                double fromBefore = depositors[from].balance();
+                double toBefore = depositors[to].balance();
+                if (!std::isfinite(toBefore + amount)) {
+                    throw InvalidInputException("Transfer amount is too large for the receiving account");
+                }
+                depositors[from].withdraw(amount);
+                depositors[to].credit(amount);
+                long long timestamp = now();
+                recordTransaction(static_cast<size_t>(from), TransactionKind::TransferOut, -amount, timestamp);
+                recordTransaction(static_cast<size_t>(to), TransactionKind::TransferIn, amount, timestamp);
+                reindexBalance(static_cast<size_t>(from), fromBefore);
+                reindexBalance(static_cast<size_t>(to), toBefore);
+            }
+            bankMetrics.transfers.fetch_add(1, std::memory_order_relaxed);
+            message(out, "Transfer of ", amount, " made from account ID: ", fromID, " to account ID: ", toID, "\n");
+        }
+        catch (const InvalidInputException& e) {
+            bankMetrics.rejectDebit(BankMetrics::InvalidInput);
+            message(err, "Error: ", e.what(), "\n");
+        }
+        catch (const InsufficientFundsException& e) {
+            bankMetrics.rejectDebit(BankMetrics::InsufficientFunds);
+            message(err, "Error: ", e.what(), "\n");
+        }
+        return true;
+    }
+
+    double calculateTotalDeposits() const {
+        OperationScope scope(BankOperation::Total, bankMetrics);
+        Lock global = lockGlobal();
+        auto accountLocks = lockAllAccounts();
+        double total = 0;
+        for (size_t i = 0, n = depositors.size(); i < n; ++i) {
+            total += depositors[i].getDepositAmount();
+        }
+        return total;
+    }
+
+    void listDepositors() const {
+        OperationScope scope(BankOperation::List, bankMetrics);
+        Lock global = lockGlobal();
+        Lock output = lockOutput();
+        if (depositors.empty()) {
+            out << "No depositors were added.\n";
+            return;
+        }
+
+        out << "\nList of depositors:\n";
+        for (size_t i = 0, n = depositors.size(); i < n; ++i) {
+            const Depositor& depositor = depositors[i];
+            double amount = depositor.getDepositAmount(); // Can throw, so no half-printed line is left behind
+            out << "Depositor ID: " << depositor.getID()
+                << ", Name: " << depositor.getName()
+                << ", Deposit Amount: " << amount << std::endl;
+        }
+    }
+
+    // Function to collect up to count of the account's most recent transactions, newest first.
+    // Returns false if no depositor has the ID.
+    bool recentTransactions(const std::string& depositorID, size_t count, std::vector<Transaction>& result) const {
+        Lock global = lockGlobal();
+        long long slot = findSlot(depositorID);
+        if (slot < 0) {
+            return false;
+        }
+        result.clear();
+        for (unsigned long long reference = depositors[slot].lastTransactionReference();
+            reference != 0 && result.size() < count; reference = transactionLog.at(reference).previous) {
+            result.push_back(transactionLog.at(reference));
+        }
+        return true;
+    }
+
+    // Function to list the k depositors with the largest stored balances, largest first. Reads the
+    // balance index, so the cost is O(k) however many accounts there are.
+    std::vector<RankedDepositor> topK(size_t k) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The balance index is not kept");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        applyPendingIndex();
+        std::vector<RankedDepositor> result;
+        result.reserve(std::min(k, balanceIndex.size()));
+        balanceIndex.forEachLargest(k, [&](size_t slot, double balance) {
+            result.push_back({ depositors[slot].getID(), depositors[slot].getName(), balance });
+        });
+        return result;
+    }
+
+    // Function to list the depositors whose stored balance lies between low and high (inclusive),
+    // lowest first; O(log n + k) for k results
+    std::vector<RankedDepositor> depositorsInRange(double low, double high) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The balance index is not kept");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        applyPendingIndex();
+        std::vector<RankedDepositor> result;
+        balanceIndex.forEachInRange(low, high, [&](size_t slot, double balance) {
+            result.push_back({ depositors[slot].getID(), depositors[slot].getName(), balance });
+        });
+        return result;
+    }
+
+    // Function to count the depositors whose stored balance lies between low and high (inclusive) in O(log n)
+    size_t countInRange(double low, double high) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The balance index is not kept");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        applyPendingIndex();
+        return balanceIndex.countInRange(low, high);
+    }
+
+    // Function to estimate how much the poorest percent of depositors hold together, from the Fenwick prefix
+    // sums in O(log buckets); approximate, accurate to the balance bucket the boundary account falls in
+    double totalHeldByBottom(double percent) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The balance index is not kept");
+        }
+        if (percent < 0 || percent > 100) {
+            throw InvalidInputException("Percent must be between 0 and 100");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        applyPendingIndex();
+        size_t accounts = static_cast<size_t>(std::llround(balanceDistribution.count() * percent / 100));
+        return balanceDistribution.totalOfSmallest(accounts);
+    }
+
+    // Function to find the share of depositors, in percent, whose stored balance is lower than this
+    // account's. Uses the balance index's prefix counts, so it is exact and O(log n).
+    // Returns false if no depositor has the ID.
+    bool percentileRank(const std::string& depositorID, double& percentile) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The balance index is not kept");
+        }
+        Lock global = lockGlobal();
+        long long slot = findSlot(depositorID);
+        if (slot < 0) {
+            return false;
+        }
+        Lock index = lockIndex();
+        applyPendingIndex();
+        // The index lock comes first, as in every query; changes queued since are applied under the stripe
+        Lock account = lockAccount(static_cast<size_t>(slot));
+        if (account.owns_lock()) {
+            applyQueuedChanges(shards[slot % kShards]);
+        }
+        size_t below = balanceIndex.countBelow(BalanceIndex::Key{ depositors[slot].balance(), 0 });
+        percentile = 100.0 * double(below) / double(balanceIndex.size());
+        return true;
+    }
+
+    // Function to report count, sum, min, max and a balance histogram per deposit strategy. Everything
+    // but min and max is read from the aggregates; those come from the group's extreme histogram bucket
+    // by scanning that bucket's stretch of the balance index for the first account of the group.
+    std::vector<StrategySummary> strategySummaries() const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The balance index is not kept");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        applyPendingIndex();
+        std::vector<StrategySummary> result;
+        for (int group = 0; group < static_cast<int>(strategyAggregates.groupCount()); ++group) {
+            StrategySummary summary = strategyAggregates.summary(group);
+            auto inGroup = [&](size_t slot) { return depositors[slot].getStrategyGroup() == group; };
+            double low, high;
+            BalanceIndex::Key found;
+            if (strategyAggregates.extremeBucket(group, false, low, high) && balanceIndex.findLowest(low, high, inGroup, found)) {
+                summary.min = found.balance;
+            }
+            if (strategyAggregates.extremeBucket(group, true, low, high) && balanceIndex.findHighest(low, high, inGroup, found)) {
+                summary.max = found.balance;
+            }
+            result.push_back(std::move(summary));
+        }
+        return result;
+    }
+
+    // Function to attach a tag (letters, digits, '-' or '_') to an account; tagging twice has no effect.
+    // Returns false if no depositor has the ID.
+    bool tagDepositor(const std::string& depositorID, const std::string& tag) {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The bitmap indexes are not kept");
+        }
+        if (!isValidTag(tag)) {
+            throw InvalidInputException("Invalid tag. Only letters, digits, '-' and '_' are allowed.");
+        }
+        Lock global = lockGlobal();
+        long long slot = findSlot(depositorID);
+        if (slot < 0) {
+            return false;
+        }
+        Lock index = lockIndex();
+        auto it = std::find_if(tagBitmaps.begin(), tagBitmaps.end(), [&](const auto& entry) { return entry.first == tag; });
+        if (it == tagBitmaps.end()) {
+            tagBitmaps.emplace_back(tag, RoaringBitmap());
+            it = tagBitmaps.end() - 1;
+        }
+        it->second.add(static_cast<unsigned int>(slot));
+        message(out, "Tag ", tag, " added to account ID: ", depositorID, "\n");
+        return true;
+    }
+
+    // Function to count and total the accounts matching every term of a filter. A term is a strategy
+    // label ("Fixed" or "strategy=Fixed") or "tag=<tag>"; "AND" between terms is optional. The terms'
+    // bitmaps are intersected, so the cost depends on the bitmaps' sizes rather than on a scan.
+    FilterResult filterDepositors(const std::vector<std::string>& terms) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The bitmap indexes are not kept");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        std::vector<const RoaringBitmap*> bitmaps;
+        static const RoaringBitmap empty;
+        for (const auto& term : terms) {
+            if (term == "AND" || term == "and") {
+                continue;
+            }
+            const RoaringBitmap* bitmap = &empty;
+            if (term.compare(0, 4, "tag=") == 0) {
+                for (const auto& entry : tagBitmaps) {
+                    if (entry.first == term.substr(4)) {
+                        bitmap = &entry.second;
+                    }
+                }
+            }
+            else {
+                std::string label = term.compare(0, 9, "strategy=") == 0 ? term.substr(9) : term;
+                for (int group = 0; group < static_cast<int>(strategyAggregates.groupCount()); ++group) {
+                    if (strategyAggregates.label(group) == label && static_cast<size_t>(group) < strategyBitmaps.size()) {
+                        bitmap = &strategyBitmaps[group];
+                    }
+                }
+            }
+            bitmaps.push_back(bitmap);
+        }
+        if (bitmaps.empty()) {
+            throw InvalidInputException("Filter needs at least one term");
+        }
+
+        // Intersect smallest first so intermediate results stay small
+        std::sort(bitmaps.begin(), bitmaps.end(),
+            [](const RoaringBitmap* a, const RoaringBitmap* b) { return a->cardinality() < b->cardinality(); });
+        RoaringBitmap intersection;
+        const RoaringBitmap* matches = bitmaps[0];
+        for (size_t i = 1; i < bitmaps.size(); ++i) {
+            intersection = RoaringBitmap::intersect(*matches, *bitmaps[i]);
+            matches = &intersection;
+        }
+        FilterResult result;
+        matches->forEach([&](unsigned int slot) {
+            ++result.count;
+            result.total += depositors[slot].balance();
+        });
+        return result;
+    }
+
+    // Function to find depositors by name, case-insensitively: names starting with the text (in name
+    // order) or, with substring set, names containing it. Returns at most limit matches.
+    std::vector<RankedDepositor> searchNames(const std::string& text, bool substring, size_t limit) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The name index is not kept");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        std::vector<RankedDepositor> result;
+        auto collect = [&](size_t slot) {
+            if (result.size() >= limit) {
+                return false;
+            }
+            result.push_back({ depositors[slot].getID(), depositors[slot].getName(), depositors[slot].balance() });
+            return true;
+        };
+        if (substring) {
+            nameIndex.forEachContaining(text, collect);
+        }
+        else {
+            nameIndex.forEachWithPrefix(text, collect);
+        }
+        return result;
+    }
+
+    // Function to find the names closest to the text ("did you mean"): up to limit depositors within
+    // maxDistance edits, closest first, then by name. Scans every name with a bit-parallel edit distance
+    // on all cores.
+    std::vector<NameMatch> similarNames(const std::string& text, int maxDistance, size_t limit) const {
+        if (!options.indexBalances) {
+            throw InvalidInputException("The name index is not kept");
+        }
+        if (maxDistance < 0) {
+            throw InvalidInputException("Edit distance cannot be negative");
+        }
+        Lock global = lockGlobal();
+        Lock index = lockIndex();
+        std::vector<std::pair<int, size_t>> found;
+        nameIndex.forEachSimilar(text, maxDistance, std::thread::hardware_concurrency(),
+            [&](size_t slot, int distance) { found.push_back({ distance, slot }); });
+        auto closer = [&](const std::pair<int, size_t>& a, const std::pair<int, size_t>& b) {
+            if (a.first != b.first) {
+                return a.first < b.first;
+            }
+            const std::string& nameA = depositors[a.second].getName();
+            const std::string& nameB = depositors[b.second].getName();
+            return nameA != nameB ? nameA < nameB : a.second < b.second;
+        };
+        size_t shown = std::min(limit, found.size());
+        std::partial_sort(found.begin(), found.begin() + shown, found.end(), closer);
+        std::vector<NameMatch> result;
+        for (size_t i = 0; i < shown; ++i) {
+            const Depositor& depositor = depositors[found[i].second];
+            result.push_back({ depositor.getID(), depositor.getName(), found[i].first });
+        }
+        return result;
+    }
+
+    // Function to pay one rate per deposit strategy (parts per million per period, negative for fees) to
+    // every account, compounded over the given number of periods in whole cents; strategies without a
+    // rate are skipped. The accounts are split into contiguous ranges, one per thread, and each account
+    // does all its periods in integer cents at once (see Depositor::accrueInterest). The balance
+    // indexes are then brought up to date in one pass over the accounts that changed. Deposits,
+    // withdrawals, transfers and new accounts wait until the pass is done. A pass that could compound
+    // any balance past kMaxInterestCents is refused before anything is paid.
+    AccrualResult accrueInterest(const std::vector<std::pair<std::string, long long>>& ratesPerMillion, unsigned periods,
+        unsigned threads = std::thread::hardware_concurrency()) {
+        for (const auto& rate : ratesPerMillion) {
+            if (rate.second < -1000000 || rate.second > 1000000) {
+                throw InvalidInputException("Interest rate must be between -100% and 100% per period");
+            }
+        }
+        if (periods > kMaxInterestPeriods) {
+            throw InvalidInputException("At most " + std::to_string(kMaxInterestPeriods) + " interest periods are supported");
+        }
+        Lock global = lockGlobal();
+        Lock adding = concurrent() ? Lock(addMutex) : Lock();
+        Lock index = lockIndex(); // Before the stripes, as in every query
+        std::array<Lock, kShards> accountLocks;
+        if (concurrent()) {
+            for (size_t i = 0; i < kShards; ++i) {
+                accountLocks[i] = Lock(shards[i].mutex);
+            }
+        }
+
+        std::vector<long long> groupRates(strategyAggregates.groupCount(), 0);
+        for (const auto& rate : ratesPerMillion) {
+            int group = strategyAggregates.findGroup(rate.first);
+            if (group >= 0) {
+                groupRates[group] = rate.second;
+            }
+        }
+
+        AccrualResult result;
+        size_t count = depositors.size();
+        if (periods == 0 || count == 0) {
+            return result;
+        }
+        // Rounding down never pays more than exact compounding of the balance plus the carried cent
+        std::vector<double> growth(groupRates.size()); // Natural log of each group's growth over the pass
+        for (size_t group = 0; group < groupRates.size(); ++group) {
+            growth[group] = groupRates[group] > 0 ? periods * std::log1p(groupRates[group] / 1e6) : 0;
+        }
+        for (size_t slot = 0; slot < count; ++slot) {
+            double rise = growth[depositors[slot].getStrategyGroup()];
+            if (rise > 0 && std::log(depositors[slot].balance() * 100 + 1) + rise > std::log(kMaxInterestCents)) {
+                throw InvalidInputException("Interest over " + std::to_string(periods) + " periods would take account "
+                    + depositors[slot].getID() + " past the largest supported balance");
+            }
+        }
+        threads = count < 65536 ? 1 : std::max(1u, threads);
+        long long timestamp = now();
+        std::vector<long long> credited(threads, 0);
+        std::vector<std::vector<std::pair<size_t, double>>> changed(threads); // Slot and balance before
+        auto accrue = [&](unsigned part) {
+            for (size_t slot = count * part / threads, end = count * (part + 1) / threads; slot < end; ++slot) {
+                Depositor& depositor = depositors[slot];
+                long long rate = groupRates[depositor.getStrategyGroup()];
+                if (rate == 0) {
+                    continue;
+                }
+                double before = depositor.balance();
+                long long cents = depositor.accrueInterest(rate, periods);
+                if (cents == 0) {
+                    continue;
+                }
+                credited[part] += cents;
+                changed[part].push_back({ slot, before });
+                recordTransaction(slot, TransactionKind::Interest, depositor.balance() - before, timestamp);
+            }
+        };
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned part = 1; part < threads; ++part) {
+            workers.emplace_back(accrue, part);
+        }
+        accrue(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        auto accrued = std::chrono::steady_clock::now();
+        result.seconds = std::chrono::duration<double>(accrued - start).count();
+
+        long long creditedCents = 0;
+        for (unsigned part = 0; part < threads; ++part) {
+            creditedCents += credited[part];
+            result.accounts += changed[part].size();
+        }
+        result.credited = double(creditedCents) / 100;
+        atomicAdd(bankMetrics.totalBalance, result.credited);
+
+        if (options.indexBalances) {
+            // Every stripe and the index lock are held: earlier queued changes go first, then the interest
+            if (concurrent()) {
+                for (auto& shard : shards) {
+                    applyQueuedChanges(shard);
+                }
+            }
+            for (const auto& part : changed) {
+                for (const auto& change : part) {
+                    applyBalanceChange({ change.first, change.second, depositors[change.first].balance() });
+                }
+            }
+            result.indexSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - accrued).count();
+        }
+        return result;
+    }
+
+    // Function to find the account's balance as it was at the given time (0 before its first transaction).
+    // The checkpoints are binary searched for the first one after that time, and the chain is walked
+    // back from there, which takes at most checkpointInterval steps. Returns false if no depositor has the ID.
+    bool balanceAt(const std::string& depositorID, long long timestampNs, double& balance) const {
+        if (!options.recordHistory) {
+            throw InvalidInputException("Transaction history is not recorded");
+        }
+        Lock global = lockGlobal();
+        long long slot = findSlot(depositorID);
+        if (slot < 0) {
+            return false;
+        }
+        Lock account = lockAccount(static_cast<size_t>(slot));
+        const Depositor& depositor = depositors[slot];
+        const auto& checkpoints = depositor.checkpoints();
+        auto after = std::upper_bound(checkpoints.begin(), checkpoints.end(), timestampNs,
+            [](long long t, const BalanceCheckpoint& checkpoint) { return t < checkpoint.timestampNs; });
+        unsigned long long reference = after != checkpoints.end() ? after->reference : depositor.lastTransactionReference();
+        while (reference != 0 && transactionLog.at(reference).timestampNs > timestampNs) {
+            reference = transactionLog.at(reference).previous;
+        }
+        balance = reference != 0 ? transactionLog.at(reference).balanceAfter : 0;
+        return true;
+    }
+
+    // Function to measure the memory held by the bank, by structure
+    MemoryFootprint memoryFootprint() const {
+        Lock global = lockGlobal();
+        MemoryFootprint footprint;
+        footprint.records = depositors.capacityBytes();
+        footprint.history = transactionLog.memoryBytes();
+        for (size_t i = 0, n = depositors.size(); i < n; ++i) {
+            footprint.names += depositors[i].heapBytes();
+            footprint.history += depositors[i].checkpointBytes();
+        }
+        Lock index = lockIndex();
+        applyPendingIndex();
+        footprint.indexes = idIndex.memoryBytes() + balanceIndex.memoryBytes() + balanceDistribution.memoryBytes()
+            + strategyAggregates.memoryBytes();
+        for (const auto& bitmap : strategyBitmaps) {
+            footprint.indexes += bitmap.memoryBytes();
+        }
+        for (const auto& tag : tagBitmaps) {
+            footprint.indexes += tag.second.memoryBytes();
+        }
+        footprint.names += nameIndex.memoryBytes();
+        footprint.fixed = sizeof(Bank);
+        return footprint;
+    }
+
+    // Function to report how often each lock was contended and how long callers waited for it
+    std::vector<LockStats> lockStats() const {
+        auto stats = [](const std::string& name, const InstrumentedMutex& m) {
+            return LockStats{ name, m.acquisitionCount(), m.contendedCount(), m.waitNanoseconds() / 1e9 };
+        };
+        LockStats shardTotals{ "account-stripes", 0, 0, 0 };
+        for (const auto& shard : shards) {
+            shardTotals.acquisitions += shard.mutex.acquisitionCount();
+            shardTotals.contended += shard.mutex.contendedCount();
+            shardTotals.waitSeconds += shard.mutex.waitNanoseconds() / 1e9;
+        }
+        return { stats("global", globalMutex), stats("add", addMutex), shardTotals, stats("output", outputMutex),
+            stats("balance-index", indexMutex) };
+    }
+};
+
+// Port for the Prometheus metrics endpoint (0 = disabled), set with --metrics-port
+int metricsPort = 0;
+
+// Function to render a bank's metrics in the Prometheus text exposition format
+void writePrometheusMetrics(const Bank& bank, double depositsPerSecond, std::ostream& os) {
+    const BankMetrics& m = bank.metrics();
+    os << "# HELP bank_accounts Number of depositor accounts.\n# TYPE bank_accounts gauge\n"
+        << "bank_accounts " << m.accounts.load(std::memory_order_relaxed) << "\n";
+    os << "# HELP bank_deposits_total Deposits credited to accounts.\n# TYPE bank_deposits_total counter\n"
+        << "bank_deposits_total " << m.deposits.load(std::memory_order_relaxed) << "\n";
+    os << "# HELP bank_deposits_per_second Deposit rate since the previous scrape.\n# TYPE bank_deposits_per_second gauge\n"
+        << "bank_deposits_per_second " << depositsPerSecond << "\n";
+    os << "# HELP bank_deposits_rejected_total Rejected deposits by reason.\n# TYPE bank_deposits_rejected_total counter\n";
+    for (int i = 0; i < BankMetrics::RejectionCount; ++i) {
+        os << "bank_deposits_rejected_total{reason=\"" << BankMetrics::rejectionName(i) << "\"} "
+            << m.rejectedDeposits[i].load(std::memory_order_relaxed) << "\n";
+    }
+    os << "# HELP bank_withdrawals_total Completed withdrawals.\n# TYPE bank_withdrawals_total counter\n"
+        << "bank_withdrawals_total " << m.withdrawals.load(std::memory_order_relaxed) << "\n";
+    os << "# HELP bank_transfers_total Completed transfers.\n# TYPE bank_transfers_total counter\n"
+        << "bank_transfers_total " << m.transfers.load(std::memory_order_relaxed) << "\n";
+    os << "# HELP bank_debits_rejected_total Rejected withdrawals and transfers by reason.\n"
+        << "# TYPE bank_debits_rejected_total counter\n";
+    for (int i = 0; i < BankMetrics::RejectionCount; ++i) {
+        os << "bank_debits_rejected_total{reason=\"" << BankMetrics::rejectionName(i) << "\"} "
+            << m.rejectedDebits[i].load(std::memory_order_relaxed) << "\n";
+    }
+    os << "# HELP bank_balance_total Sum of all account balances.\n# TYPE bank_balance_total gauge\n"
+        << "bank_balance_total " << std::setprecision(17) << m.totalBalance.load(std::memory_order_relaxed)
+        << std::setprecision(6) << "\n";
+    os << "# HELP bank_operations_in_flight Bank operations currently executing (request queue depth).\n"
+        << "# TYPE bank_operations_in_flight gauge\n"
+        << "bank_operations_in_flight " << m.operationsInFlight.load(std::memory_order_relaxed) << "\n";
+
+    LatencyRecorder& recorder = LatencyRecorder::instance();
+    if (recorder.enabled()) {
+        auto set = recorder.merged();
+        os << "# HELP bank_operation_latency_seconds Operation latency.\n# TYPE bank_operation_latency_seconds summary\n";
+        for (size_t i = 0; i < LatencyRecorder::kOperations; ++i) {
+            const LatencyHistogram& h = (*set)[i];
+            const char* name = operationName(static_cast<BankOperation>(i));
+            for (double q : { 0.5, 0.99, 0.999 }) {
+                os << "bank_operation_latency_seconds{operation=\"" << name << "\",quantile=\"" << q << "\"} "
+                    << h.percentile(q) / 1e9 << "\n";
+            }
+            os << "bank_operation_latency_seconds_count{operation=\"" << name << "\"} " << h.count() << "\n";
+        }
+    }
+}
+
+// Minimal HTTP server on 127.0.0.1 that answers every request with the bank's metrics.
+// It runs on its own thread and only reads atomics, so it never blocks Bank operations.
+class MetricsServer {
+public:
+    MetricsServer(const Bank& bank, int port) : bank(bank) {
+#if defined(__unix__) || defined(__APPLE__)
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<unsigned short>(port));
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listenFd, 16) != 0) {
+            if (listenFd >= 0) {
+                close(listenFd);
+            }
+            throw InvalidInputException("Cannot listen on metrics port " + std::to_string(port));
+        }
+        worker = std::thread([this] { serve(); });
+#else
+        (void)port;
+        throw InvalidInputException("The metrics endpoint is only supported on POSIX systems");
+#endif
+    }
+
+    ~MetricsServer() {
+#if defined(__unix__) || defined(__APPLE__)
+        stopping.store(true);
+        shutdown(listenFd, SHUT_RDWR); // Wakes the blocked accept()
+        if (worker.joinable()) {
+            worker.join();
+        }
+        close(listenFd);
+#endif
+    }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+private:
+#if defined(__unix__) || defined(__APPLE__)
+    void serve() {
+        auto lastScrape = std::chrono::steady_clock::now();
+        unsigned long long lastDeposits = 0;
+        while (!stopping.load()) {
+            int client = accept(listenFd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            char request[1024];
+            ssize_t received = recv(client, request, sizeof(request), 0); // Request line is not inspected
+            (void)received;
+
+            auto now = std::chrono::steady_clock::now();
+            unsigned long long deposits = bank.metrics().deposits.load(std::memory_order_relaxed);
+            double seconds = std::chrono::duration<double>(now - lastScrape).count();
+            double rate = seconds > 0 ? (deposits - lastDeposits) / seconds : 0;
+            lastScrape = now;
+            lastDeposits = deposits;
+
+            std::ostringstream body;
+            writePrometheusMetrics(bank, rate, body);
+            std::string text = body.str();
+            std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                + std::to_string(text.size()) + "\r\nConnection: close\r\n\r\n" + text;
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t n = send(client, response.data() + sent, response.size() - sent, 0);
+                if (n <= 0) {
+                    break;
+                }
+                sent += static_cast<size_t>(n);
+            }
+            close(client);
+        }
+    }
+
+    int listenFd = -1;
+    std::thread worker;
+#endif
+    const Bank& bank;
+    std::atomic<bool> stopping{ false };
+};
+
+// Function to start the metrics endpoint for a bank if --metrics-port was given
+std::unique_ptr<MetricsServer> startMetricsServer(const Bank& bank) {
+    if (metricsPort <= 0) {
+        return nullptr;
+    }
+    auto server = std::make_unique<MetricsServer>(bank, metricsPort);
+    std::cerr << "Serving Prometheus metrics on http://127.0.0.1:" << metricsPort << "/metrics\n";
+    return server;
+}
+
+// Stream buffer that discards everything written to it (used to silence Bank output in benchmarks)
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+};
+
+// Hardware performance counters read through perf_event_open (Linux only). Each counter is opened
+// separately for the calling thread in user space; counters the kernel refuses (no PMU, restrictive
+// perf_event_paranoid, containers) are reported as unavailable instead of failing the benchmark.
+class PerfCounters {
+public:
+    static constexpr int kEvents = 4;
+
+    static const char* eventName(int index) {
+        static const char* names[kEvents] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+        return names[index];
+    }
+
+    PerfCounters() {
+        fds.fill(-1);
+#ifdef __linux__
+        const unsigned long long configs[kEvents] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        for (int i = 0; i < kEvents; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available(int index) const {
+        return fds[index] >= 0;
+    }
+
+    bool anyAvailable() const {
+        for (int i = 0; i < kEvents; ++i) {
+            if (available(i)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Stops counting and returns the counts, scaled for multiplexing; unavailable counters are -1
+    std::array<double, kEvents> stop() {
+        std::array<double, kEvents> values;
+        values.fill(-1);
+#ifdef __linux__
+        for (int i = 0; i < kEvents; ++i) {
+            if (fds[i] < 0) {
+                continue;
+            }
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            unsigned long long data[3] = { 0, 0, 0 }; // value, time enabled, time running
+            if (read(fds[i], data, sizeof(data)) == static_cast<ssize_t>(sizeof(data)) && data[2] > 0) {
+                values[i] = double(data[0]) * double(data[1]) / double(data[2]);
+            }
+        }
+#endif
+        return values;
+    }
+
+private:
+    std::array<int, kEvents> fds;
+};
+
+// Result of a single benchmark measurement
+struct BenchResult {
+    std::string operation;
+    size_t accounts;
+    unsigned long long iterations;
+    double nsPerOp;
+    double opsPerSec;
+    double allocsPerOp;
+    double bytesPerOp;
+    std::array<double, PerfCounters::kEvents> countersPerOp; // -1 when the counter is unavailable
+};
+
+// Captures time, allocation and hardware counter readings at construction and turns the difference into a result
+class BenchMeter {
+public:
+    explicit BenchMeter(PerfCounters& counters)
+        : counters(counters),
+        allocsBefore(allocationCount.load(std::memory_order_relaxed)),
+        bytesBefore(allocatedBytes.load(std::memory_order_relaxed)) {
+        counters.start();
+        start = std::chrono::steady_clock::now();
+    }
+
+    double elapsedSeconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    BenchResult finish(const std::string& name, size_t accounts, unsigned long long iterations) {
+        double elapsed = elapsedSeconds();
+        std::array<double, PerfCounters::kEvents> counts = counters.stop();
+        BenchResult result;
+        result.operation = name;
+        result.accounts = accounts;
+        result.iterations = iterations;
+        result.nsPerOp = elapsed * 1e9 / iterations;
+        result.opsPerSec = iterations / elapsed;
+        result.allocsPerOp = double(allocationCount.load(std::memory_order_relaxed) - allocsBefore) / iterations;
+        result.bytesPerOp = double(allocatedBytes.load(std::memory_order_relaxed) - bytesBefore) / iterations;
+        for (int i = 0; i < PerfCounters::kEvents; ++i) {
+            result.countersPerOp[i] = counts[i] < 0 ? -1 : counts[i] / iterations;
+        }
+        return result;
+    }
+
+private:
+    PerfCounters& counters;
+    unsigned long long allocsBefore;
+    unsigned long long bytesBefore;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Function to time an operation: runs it in growing batches until at least minSeconds have elapsed
+template <typename Operation>
+BenchResult measureOperation(const std::string& name, size_t accounts, double minSeconds,
+    PerfCounters& counters, Operation&& operation) {
+    unsigned long long iterations = 0;
+    unsigned long long batch = 1;
+    BenchMeter meter(counters);
+    while (meter.elapsedSeconds() < minSeconds) {
+        for (unsigned long long i = 0; i < batch; ++i) {
+            operation(iterations + i);
+        }
+        iterations += batch;
+        if (batch < (1ULL << 20)) {
+            batch *= 2;
+        }
+    }
+    return meter.finish(name, accounts, iterations);
+}
+
+// Function to print benchmark results as a human-readable table
+void printBenchTable(const std::vector<BenchResult>& results, std::ostream& os) {
+    os << std::left << std::setw(24) << "operation" << std::right
+        << std::setw(10) << "accounts" << std::setw(14) << "iterations"
+        << std::setw(16) << "ns/op" << std::setw(16) << "ops/sec"
+        << std::setw(12) << "allocs/op" << std::setw(12) << "bytes/op"
+        << std::setw(14) << "cycles/op" << std::setw(14) << "instr/op"
+        << std::setw(14) << "llc-miss/op" << std::setw(14) << "br-miss/op" << "\n";
+    os << std::fixed;
+    for (const auto& r : results) {
+        os << std::left << std::setw(24) << r.operation << std::right
+            << std::setw(10) << r.accounts << std::setw(14) << r.iterations
+            << std::setw(16) << std::setprecision(1) << r.nsPerOp
+            << std::setw(16) << std::setprecision(0) << r.opsPerSec
+            << std::setw(12) << std::setprecision(2) << r.allocsPerOp
+            << std::setw(12) << std::setprecision(1) << r.bytesPerOp;
+        for (double value : r.countersPerOp) {
+            os << std::setw(14);
+            if (value < 0) {
+                os << "-";
+            }
+            else {
+                os << std::setprecision(2) << value;
+            }
+        }
+        os << "\n";
+    }
+    os << std::defaultfloat;
+}
+
+// Function to write benchmark results as JSON so regressions can be tracked by tooling
+void writeBenchJson(const std::vector<BenchResult>& results, std::ostream& os) {
+    os << "{\n";
+    if (allocationTrackingEnabled.load(std::memory_order_relaxed)) {
+        os << "  \"allocations_by_operation\": {";
+        for (int i = 0; i < static_cast<int>(BankOperation::Count); ++i) {
+            os << (i ? ", " : "") << "\"" << operationName(static_cast<BankOperation>(i)) << "\": {\"calls\": "
+                << scopeOperations[i].load(std::memory_order_relaxed) << ", \"allocations\": "
+                << scopeAllocationCount[i].load(std::memory_order_relaxed) << ", \"bytes\": "
+                << scopeAllocatedBytes[i].load(std::memory_order_relaxed) << "}";
+        }
+        os << "},\n";
+    }
+    os << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << "    {\"operation\": \"" << r.operation << "\", \"accounts\": " << r.accounts
+            << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << r.nsPerOp
+            << ", \"ops_per_sec\": " << r.opsPerSec
+            << ", \"allocs_per_op\": " << r.allocsPerOp
+            << ", \"bytes_per_op\": " << r.bytesPerOp;
+        for (int c = 0; c < PerfCounters::kEvents; ++c) {
+            os << ", \"" << PerfCounters::eventName(c) << "_per_op\": ";
+            if (r.countersPerOp[c] < 0) {
+                os << "null";
+            }
+            else {
+                os << r.countersPerOp[c];
+            }
+        }
+        os << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+// Function to parse a comma-separated list of account counts (e.g. "1000,10000")
+std::vector<size_t> parseSizeList(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!isNumeric(item) || std::stod(item) < 1) {
+            throw InvalidInputException("Invalid benchmark size: " + item);
+        }
+        sizes.push_back(static_cast<size_t>(std::stod(item)));
+    }
+    return sizes;
+}
+
+// Benchmark mode: measures every Bank operation at several account counts.
+// Usage: lab3 [--alloc-track] --bench [--sizes 1000,10000,...] [--min-time seconds] [--json file]
+int runBenchmarks(const std::vector<std::string>& args) {
+    std::vector<size_t> sizes = { 1000, 10000, 100000, 500000 };
+    double minSeconds = 0.2;
+    std::string jsonPath;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--sizes" && i + 1 < args.size()) {
+            sizes = parseSizeList(args[++i]);
+            for (size_t size : sizes) {
+                checkAccountCount(size);
+            }
+        }
+        else if (args[i] == "--min-time" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            minSeconds = std::stod(args[++i]);
+        }
+        else if (args[i] == "--json" && i + 1 < args.size()) {
+            jsonPath = args[++i];
+        }
+        else {
+            throw InvalidInputException("Unknown benchmark option: " + args[i]);
+        }
+    }
+
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    NormalDeposit normal;
+    FixedDeposit fixed;
+    std::vector<BenchResult> results;
+    PerfCounters counters;
+    if (!counters.anyAvailable()) {
+        std::cerr << "Hardware performance counters are not available; reporting wall-clock numbers only.\n";
+    }
+
+    // Free functions do not depend on the number of accounts, so they are measured once
+    std::vector<std::string> names = { "Alice", "Bob", "Bad Name1", "Christopher" };
+    std::vector<std::string> numbers = { "100", "2500.75", "12abc", "-3" };
+    volatile size_t sink = 0;
+    results.push_back(measureOperation("generateRandomID", 0, minSeconds, counters, [&](unsigned long long) {
+        sink += generateRandomID().size();
+    }));
+    results.push_back(measureOperation("isValidName", 0, minSeconds, counters, [&](unsigned long long i) {
+        sink += isValidName(names[i % names.size()]);
+    }));
+    results.push_back(measureOperation("isNumeric", 0, minSeconds, counters, [&](unsigned long long i) {
+        sink += isNumeric(numbers[i % numbers.size()]);
+    }));
+
+    // A rule strategy per deposit through the interface, then the same rules over a batch of 256
+    RuleDeposit rules("Premium cap=500000 bonus=25 percent=1.5 tier=1000:10 tier=10000:150 tier=100000:2000");
+    const IDeposit* ruleStrategy = &rules;
+    std::vector<double> amounts(256), credited(256);
+    std::mt19937_64 amountGen(42);
+    for (auto& amount : amounts) {
+        amount = double(amountGen() % 1000000);
+    }
+    results.push_back(measureOperation("ruleDeposit", 0, minSeconds, counters, [&](unsigned long long i) {
+        double amount = amounts[i % amounts.size()];
+        sink += amount > 500000 ? 0 : static_cast<size_t>(ruleStrategy->calculateDeposit(amount));
+    }));
+    results.push_back(measureOperation("ruleDepositBatch(256)", 0, minSeconds, counters, [&](unsigned long long) {
+        sink += rules.calculateDeposits(amounts.data(), credited.data(), amounts.size());
+        sink += static_cast<size_t>(credited[0]);
+    }));
+
+    // Tier lookup on amounts spread evenly over the brackets, so an if-chain cannot predict its exit
+    TieredDeposit tiered;
+    std::vector<double> tierAmounts(4096);
+    for (auto& amount : tierAmounts) {
+        amount = std::pow(10.0, 1.0 + 5.0 * double(amountGen() % 100000) / 100000);
+    }
+    results.push_back(measureOperation("tieredBonus", 0, minSeconds, counters, [&](unsigned long long i) {
+        sink += static_cast<size_t>(tiered.bonusBrackets().bonus(tierAmounts[i % tierAmounts.size()]));
+    }));
+    results.push_back(measureOperation("tieredBonusIfChain", 0, minSeconds, counters, [&](unsigned long long i) {
+        sink += static_cast<size_t>(tiered.bonusBrackets().bonusByIfChain(tierAmounts[i % tierAmounts.size()]));
+    }));
+
+    for (size_t accounts : sizes) {
+        Bank bank(nullStream, nullStream, makeBankOptions());
+        std::vector<std::string> ids;
+        ids.reserve(accounts);
+
+        // addDepositor is measured while the bank is populated up to the requested size
+        BenchMeter meter(counters);
+        for (size_t i = 0; i < accounts; ++i) {
+            ids.push_back(bank.addDepositor("Depositor", i % 2 ? static_cast<const IDeposit*>(&fixed) : &normal));
+        }
+        results.push_back(meter.finish("addDepositor", accounts, accounts));
+
+        std::mt19937_64 gen(accounts);
+        std::uniform_int_distribution<size_t> pick(0, accounts - 1);
+        results.push_back(measureOperation("depositToAccount", accounts, minSeconds, counters, [&](unsigned long long) {
+            sink += bank.depositToAccount(ids[pick(gen)], 10);
+        }));
+        std::vector<std::pair<std::string, double>> batch(64);
+        results.push_back(measureOperation("depositMany(64)", accounts, minSeconds, counters, [&](unsigned long long) {
+            for (auto& deposit : batch) {
+                deposit = { ids[pick(gen)], 10 };
+            }
+            sink += bank.depositMany(batch).applied;
+        }));
+        results.push_back(measureOperation("calculateTotalDeposits", accounts, minSeconds, counters, [&](unsigned long long) {
+            sink += static_cast<size_t>(bank.calculateTotalDeposits());
+        }));
+        results.push_back(measureOperation("listDepositors", accounts, minSeconds, counters, [&](unsigned long long) {
+            bank.listDepositors();
+        }));
+        results.push_back(measureOperation("topK(10)", accounts, minSeconds, counters, [&](unsigned long long) {
+            sink += bank.topK(10).size();
+        }));
+        results.push_back(measureOperation("countInRange", accounts, minSeconds, counters, [&](unsigned long long i) {
+            sink += bank.countInRange(double(i % 1000), double(i % 1000) + 500);
+        }));
+        results.push_back(measureOperation("filterDepositors", accounts, minSeconds, counters, [&](unsigned long long) {
+            sink += bank.filterDepositors({ "Fixed" }).count;
+        }));
+        results.push_back(measureOperation("strategySummaries", accounts, minSeconds, counters, [&](unsigned long long) {
+            sink += bank.strategySummaries().size();
+        }));
+        results.push_back(measureOperation("totalHeldByBottom", accounts, minSeconds, counters, [&](unsigned long long i) {
+            sink += static_cast<size_t>(bank.totalHeldByBottom(double(i % 100)));
+        }));
+        std::cerr << "Benchmarked " << accounts << " accounts\n";
+    }
+
+    printBenchTable(results, std::cout);
+    if (allocationTrackingEnabled.load(std::memory_order_relaxed)) {
+        reportAllocations(std::cout);
+    }
+    if (!jsonPath.empty()) {
+        std::ofstream json(jsonPath);
+        if (!json) {
+            throw InvalidInputException("Cannot open benchmark output file: " + jsonPath);
+        }
+        writeBenchJson(results, json);
+    }
+    return 0;
+}
+
+// Zipf distribution over ranks [0, n): rank k is drawn with probability proportional to 1 / (k + 1)^skew
+class ZipfDistribution {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfDistribution(size_t n, double skew) : cdf(n) {
+        double sum = 0;
+        for (size_t k = 0; k < n; ++k) {
+            sum += 1.0 / std::pow(double(k + 1), skew);
+            cdf[k] = sum;
+        }
+        for (auto& value : cdf) {
+            value /= sum;
+        }
+    }
+
+    template <typename Generator>
+    size_t operator()(Generator& gen) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+        return rank < cdf.size() ? rank : cdf.size() - 1;
+    }
+};
+
+// Parameters of a synthetic workload
+struct WorkloadConfig {
+    unsigned long long seed = 1;
+    size_t accounts = 1000;    // Number of valid depositors to create
+    size_t operations = 10000; // Number of deposit/read operations after the population is created
+    double fixedRatio = 0.5;   // Fraction of depositors using the Fixed strategy
+    double zipfSkew = 1.0;     // 0 gives uniform traffic, larger values concentrate deposits on fewer accounts
+    double invalidRate = 0.0;  // Fraction of adds and deposits carrying invalid input
+    double readRatio = 0.1;    // Fraction of operations that read the total instead of depositing
+};
+
+// Function to parse an interest rate term "<strategy>=<percent per period>" into the strategy label and
+// the rate in parts per million. Returns false if the term is malformed.
+bool parseInterestRate(const std::string& term, std::pair<std::string, long long>& rate) {
+    size_t equals = term.find('=');
+    if (equals == 0 || equals == std::string::npos || !isNumeric(term.substr(equals + 1))) {
+        return false;
+    }
+    double percent = std::stod(term.substr(equals + 1));
+    if (!std::isfinite(percent) || std::fabs(percent) > 100) {
+        return false;
+    }
+    rate = { term.substr(0, equals), std::llround(percent * 10000) };
+    return true;
+}
+
+// A single workload operation, in the same form as a batch command line
+struct WorkloadOp {
+    enum class Type { Add, Deposit, Total, List, Stats, Advance, Withdraw, Transfer, History, BalanceAt, Top, Range, Count, Bottom, Percentile, Groups, Tag, Filter, Find, Search, Fuzzy, Interest, Configure, DepositMany };
+    Type type;
+    std::string name;        // Add: depositor name; Find/Search: text to look for
+    std::string strategy;    // Add/Configure: strategy name (normal, fixed, tiered or one loaded with --strategies)
+    std::string target;      // Deposit/Withdraw/Transfer source: "@k" for the k-th depositor added in this session, or a literal ID
+    std::string destination; // Transfer: receiving account, same forms as target
+    std::string amount;      // Amount as typed by a user (may be invalid); Advance: seconds; History/Top/Find/Search/Fuzzy: entry count; Interest: periods
+    std::string timestamp;   // BalanceAt: UTC time as YYYY-MM-DDTHH:MM:SS
+    std::string tag;         // Tag: tag to attach; Fuzzy: maximum edit distance
+    std::vector<std::string> terms; // Filter: strategy labels and tag=<tag> terms; Interest: <strategy>=<percent> rates; Configure: rules; DepositMany: <account>:<amount> pairs
+    double low = 0;          // Range/Count: inclusive balance bounds; Bottom: percent of depositors
+    double high = 0;
+};
+
+// Counters collected while replaying a workload
+struct WorkloadStats {
+    size_t adds = 0;
+    size_t deposits = 0;
+    size_t withdrawals = 0;
+    size_t transfers = 0;
+    size_t reads = 0;
+    size_t rejectedNames = 0;
+    size_t rejectedAmounts = 0;
+    size_t unknownAccounts = 0;
+    size_t failedReads = 0;
+    size_t failedCommands = 0;
+};
+
+// Function to generate a random name of letters only
+template <typename Generator>
+std::string generateName(Generator& gen) {
+    std::uniform_int_distribution<int> length(5, 10);
+    std::uniform_int_distribution<int> letter(0, 25);
+    std::string name(length(gen), 'a');
+    for (auto& c : name) {
+        c = static_cast<char>('a' + letter(gen));
+    }
+    name[0] = static_cast<char>(std::toupper(name[0]));
+    return name;
+}
+
+// Function to generate a seeded workload: the account population followed by a Zipf-skewed operation stream
+std::vector<WorkloadOp> generateWorkload(const WorkloadConfig& config) {
+    std::mt19937_64 gen(config.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<long long> cents(100, 500000);
+    std::vector<WorkloadOp> ops;
+    ops.reserve(config.accounts + config.operations);
+
+    for (size_t created = 0; created < config.accounts;) {
+        WorkloadOp op;
+        op.type = WorkloadOp::Type::Add;
+        op.name = generateName(gen);
+        op.strategy = chance(gen) < config.fixedRatio ? "fixed" : "normal";
+        if (chance(gen) < config.invalidRate) {
+            op.name += std::to_string(created % 10); // Digits make the name invalid
+        }
+        else {
+            ++created;
+        }
+        ops.push_back(op);
+    }
+    if (config.accounts == 0) {
+        return ops;
+    }
+
+    // Hot ranks are mapped to random accounts so hotspots are not simply the oldest depositors
+    std::vector<size_t> rankToAccount(config.accounts);
+    for (size_t i = 0; i < rankToAccount.size(); ++i) {
+        rankToAccount[i] = i;
+    }
+    std::shuffle(rankToAccount.begin(), rankToAccount.end(), gen);
+    ZipfDistribution zipf(config.accounts, config.zipfSkew);
+
+    for (size_t i = 0; i < config.operations; ++i) {
+        WorkloadOp op;
+        if (chance(gen) < config.readRatio) {
+            op.type = WorkloadOp::Type::Total;
+            ops.push_back(op);
+            continue;
+        }
+        op.type = WorkloadOp::Type::Deposit;
+        op.target = "@" + std::to_string(rankToAccount[zipf(gen)]);
+        long long value = cents(gen);
+        op.amount = std::to_string(value / 100) + "." + std::to_string(value % 100 / 10) + std::to_string(value % 10);
+        if (chance(gen) < config.invalidRate) {
+            switch (gen() % 4) {
+            case 0: op.amount = "12abc"; break;       // Not numeric
+            case 1: op.amount = "-" + op.amount; break; // Negative
+            case 2: op.target = "PZ000000"; break;    // Unknown account (generated IDs start at 100000)
+            default: op.amount = "2000000"; break;    // Above the Fixed strategy cap
+            }
+        }
+        ops.push_back(op);
+    }
+    return ops;
+}
+
+// Function to format a workload operation as a batch command line
+std::string formatWorkloadOp(const WorkloadOp& op) {
+    switch (op.type) {
+    case WorkloadOp::Type::Add:
+        return "add " + op.name + " " + op.strategy;
+    case WorkloadOp::Type::Deposit:
+        return "deposit " + op.target + " " + op.amount;
+    case WorkloadOp::Type::Total:
+        return "total";
+    case WorkloadOp::Type::List:
+        return "list";
+    case WorkloadOp::Type::Advance:
+        return "advance " + op.amount;
+    case WorkloadOp::Type::Withdraw:
+        return "withdraw " + op.target + " " + op.amount;
+    case WorkloadOp::Type::Transfer:
+        return "transfer " + op.target + " " + op.destination + " " + op.amount;
+    case WorkloadOp::Type::History:
+        return "history " + op.target + " " + op.amount;
+    case WorkloadOp::Type::BalanceAt:
+        return "balance-at " + op.target + " " + op.timestamp;
+    case WorkloadOp::Type::Top:
+        return "top " + op.amount;
+    case WorkloadOp::Type::Bottom: {
+        std::ostringstream line;
+        line << "bottom " << op.low;
+        return line.str();
+    }
+    case WorkloadOp::Type::Percentile:
+        return "percentile " + op.target;
+    case WorkloadOp::Type::Groups:
+        return "groups";
+    case WorkloadOp::Type::Tag:
+        return "tag " + op.target + " " + op.tag;
+    case WorkloadOp::Type::Find:
+        return "find " + op.name + " " + op.amount;
+    case WorkloadOp::Type::Search:
+        return "search " + op.name + " " + op.amount;
+    case WorkloadOp::Type::Fuzzy:
+        return "fuzzy " + op.name + " " + op.tag + " " + op.amount;
+    case WorkloadOp::Type::Filter: {
+        std::string line = "filter";
+        for (const auto& term : op.terms) {
+            line += " " + term;
+        }
+        return line;
+    }
+    case WorkloadOp::Type::Interest: {
+        std::string line = "interest " + op.amount;
+        for (const auto& term : op.terms) {
+            line += " " + term;
+        }
+        return line;
+    }
+    case WorkloadOp::Type::DepositMany: {
+        std::string line = "deposit-many";
+        for (const auto& term : op.terms) {
+            line += " " + term;
+        }
+        return line;
+    }
+    case WorkloadOp::Type::Configure: {
+        std::string line = "configure " + op.strategy;
+        for (const auto& term : op.terms) {
+            line += " " + term;
+        }
+        return line;
+    }
+    case WorkloadOp::Type::Range:
+    case WorkloadOp::Type::Count: {
+        std::ostringstream line;
+        line << (op.type == WorkloadOp::Type::Range ? "range " : "count ") << op.low << " " << op.high;
+        return line.str();
+    }
+    default:
+        return "stats";
+    }
+}
+
+// Function to parse a batch command line; blank lines and '#' comments yield false
+bool parseWorkloadOp(const std::string& line, WorkloadOp& op) {
+    std::stringstream ss(line);
+    std::string command;
+    if (!(ss >> command) || command[0] == '#') {
+        return false;
+    }
+    op = WorkloadOp();
+    if (command == "add") {
+        if (!(ss >> op.name >> op.strategy) || !findStrategy(op.strategy)) {
+            throw InvalidInputException("Usage: add <name> <normal|fixed|tiered|strategy from --strategies>");
+        }
+        op.type = WorkloadOp::Type::Add;
+    }
+    else if (command == "deposit") {
+        if (!(ss >> op.target >> op.amount)) {
+            throw InvalidInputException("Usage: deposit <ID|@index> <amount>");
+        }
+        op.type = WorkloadOp::Type::Deposit;
+    }
+    else if (command == "withdraw") {
+        if (!(ss >> op.target >> op.amount)) {
+            throw InvalidInputException("Usage: withdraw <ID|@index> <amount>");
+        }
+        op.type = WorkloadOp::Type::Withdraw;
+    }
+    else if (command == "transfer") {
+        if (!(ss >> op.target >> op.destination >> op.amount)) {
+            throw InvalidInputException("Usage: transfer <from ID|@index> <to ID|@index> <amount>");
+        }
+        op.type = WorkloadOp::Type::Transfer;
+    }
+    else if (command == "history") {
+        if (!(ss >> op.target)) {
+            throw InvalidInputException("Usage: history <ID|@index> [count]");
+        }
+        if (!(ss >> op.amount)) {
+            op.amount = "10";
+        }
+        else if (!isNumeric(op.amount) || std::stod(op.amount) < 0) {
+            throw InvalidInputException("Usage: history <ID|@index> [count]");
+        }
+        op.type = WorkloadOp::Type::History;
+    }
+    else if (command == "balance-at") {
+        if (!(ss >> op.target >> op.timestamp)) {
+            throw InvalidInputException("Usage: balance-at <ID|@index> <YYYY-MM-DDTHH:MM:SS>");
+        }
+        parseTimestamp(op.timestamp);
+        op.type = WorkloadOp::Type::BalanceAt;
+    }
+    else if (command == "top") {
+        if (!(ss >> op.amount)) {
+            op.amount = "10";
+        }
+        else if (!isNumeric(op.amount) || std::stod(op.amount) < 0) {
+            throw InvalidInputException("Usage: top [count]");
+        }
+        op.type = WorkloadOp::Type::Top;
+    }
+    else if (command == "range" || command == "count") {
+        std::string low, high;
+        if (!(ss >> low >> high) || !isNumeric(low) || !isNumeric(high)) {
+            throw InvalidInputException("Usage: " + command + " <low> <high>");
+        }
+        op.low = std::stod(low);
+        op.high = std::stod(high);
+        op.type = command == "range" ? WorkloadOp::Type::Range : WorkloadOp::Type::Count;
+    }
+    else if (command == "bottom") {
+        std::string percent;
+        if (!(ss >> percent) || !isNumeric(percent)) {
+            throw InvalidInputException("Usage: bottom <percent>");
+        }
+        op.low = std::stod(percent);
+        op.type = WorkloadOp::Type::Bottom;
+    }
+    else if (command == "percentile") {
+        if (!(ss >> op.target)) {
+            throw InvalidInputException("Usage: percentile <ID|@index>");
+        }
+        op.type = WorkloadOp::Type::Percentile;
+    }
+    else if (command == "groups") {
+        op.type = WorkloadOp::Type::Groups;
+    }
+    else if (command == "tag") {
+        if (!(ss >> op.target >> op.tag) || !isValidTag(op.tag)) {
+            throw InvalidInputException("Usage: tag <ID|@index> <tag> (letters, digits, '-' and '_')");
+        }
+        op.type = WorkloadOp::Type::Tag;
+    }
+    else if (command == "find" || command == "search") {
+        if (!(ss >> op.name)) {
+            throw InvalidInputException("Usage: " + command + " <text> [count]");
+        }
+        if (!(ss >> op.amount)) {
+            op.amount = "20";
+        }
+        else if (!isNumeric(op.amount) || std::stod(op.amount) < 0) {
+            throw InvalidInputException("Usage: " + command + " <text> [count]");
+        }
+        op.type = command == "find" ? WorkloadOp::Type::Find : WorkloadOp::Type::Search;
+    }
+    else if (command == "fuzzy") {
+        if (!(ss >> op.name)) {
+            throw InvalidInputException("Usage: fuzzy <text> [max distance] [count]");
+        }
+        if (!(ss >> op.tag)) {
+            op.tag = "2";
+        }
+        if (!(ss >> op.amount)) {
+            op.amount = "10";
+        }
+        if (!isNumeric(op.tag) || std::stod(op.tag) < 0 || !isNumeric(op.amount) || std::stod(op.amount) < 0) {
+            throw InvalidInputException("Usage: fuzzy <text> [max distance] [count]");
+        }
+        op.type = WorkloadOp::Type::Fuzzy;
+    }
+    else if (command == "interest") {
+        std::pair<std::string, long long> rate;
+        if (!(ss >> op.amount) || !isNumeric(op.amount) || std::stod(op.amount) < 0 || std::stod(op.amount) > Bank::kMaxInterestPeriods) {
+            throw InvalidInputException("Usage: interest <periods> <strategy>=<percent per period> ...");
+        }
+        for (std::string term; ss >> term;) {
+            if (!parseInterestRate(term, rate)) {
+                throw InvalidInputException("Usage: interest <periods> <strategy>=<percent per period> ...");
+            }
+            op.terms.push_back(term);
+        }
+        if (op.terms.empty()) {
+            throw InvalidInputException("Usage: interest <periods> <strategy>=<percent per period> ...");
+        }
+        op.type = WorkloadOp::Type::Interest;
+    }
+    else if (command == "deposit-many") {
+        for (std::string term; ss >> term;) {
+            if (term.find(':') == std::string::npos) {
+                throw InvalidInputException("Usage: deposit-many <ID|@index>:<amount>...");
+            }
+            op.terms.push_back(term);
+        }
+        if (op.terms.empty()) {
+            throw InvalidInputException("Usage: deposit-many <ID|@index>:<amount>...");
+        }
+        op.type = WorkloadOp::Type::DepositMany;
+    }
+    else if (command == "configure") {
+        if (!(ss >> op.strategy)) {
+            throw InvalidInputException("Usage: configure <strategy> <rule>...");
+        }
+        for (std::string term; ss >> term;) {
+            op.terms.push_back(term);
+        }
+        op.type = WorkloadOp::Type::Configure;
+    }
+    else if (command == "filter") {
+        for (std::string term; ss >> term;) {
+            op.terms.push_back(term);
+        }
+        if (op.terms.empty()) {
+            throw InvalidInputException("Usage: filter <strategy|tag=<tag>> [AND ...]");
+        }
+        op.type = WorkloadOp::Type::Filter;
+    }
+    else if (command == "total") {
+        op.type = WorkloadOp::Type::Total;
+    }
+    else if (command == "list") {
+        op.type = WorkloadOp::Type::List;
+    }
+    else if (command == "stats") {
+        op.type = WorkloadOp::Type::Stats;
+    }
+    else if (command == "advance") {
+        if (!(ss >> op.amount) || !isNumeric(op.amount)) {
+            throw InvalidInputException("Usage: advance <seconds>");
+        }
+        op.type = WorkloadOp::Type::Advance;
+    }
+    else {
+        throw InvalidInputException("Unknown batch command: " + command);
+    }
+    return true;
+}
+
+// Function to turn an "@k" session reference into the k-th added depositor's ID (other text is returned as is)
+std::string resolveAccount(const std::string& reference, const std::vector<std::string>& sessionIDs) {
+    if (reference.size() > 1 && reference[0] == '@' && isNumeric(reference.substr(1))) {
+        size_t index = static_cast<size_t>(std::stod(reference.substr(1)));
+        if (index < sessionIDs.size()) {
+            return sessionIDs[index];
+        }
+    }
+    return reference;
+}
+
+// Function to apply one workload operation to the bank, validating input the same way the menu does
+void applyWorkloadOp(Bank& bank, const WorkloadOp& op, std::vector<std::string>& sessionIDs, WorkloadStats& stats) {
+    switch (op.type) {
+    case WorkloadOp::Type::Add:
+        if (!isValidName(op.name)) {
+            ++stats.rejectedNames;
+            return;
+        }
+        sessionIDs.push_back(bank.addDepositor(op.name, findStrategy(op.strategy)));
+        ++stats.adds;
+        return;
+    case WorkloadOp::Type::Deposit:
+    case WorkloadOp::Type::Withdraw:
+    case WorkloadOp::Type::Transfer: {
+        if (!isNumeric(op.amount) || std::stod(op.amount) < 0) {
+            ++stats.rejectedAmounts;
+            return;
+        }
+        std::string depositorID = resolveAccount(op.target, sessionIDs);
+        double amount = std::stod(op.amount);
+        bool found;
+        if (op.type == WorkloadOp::Type::Deposit) {
+            found = bank.depositToAccount(depositorID, amount);
+            stats.deposits += found;
+        }
+        else if (op.type == WorkloadOp::Type::Withdraw) {
+            found = bank.withdrawFromAccount(depositorID, amount);
+            stats.withdrawals += found;
+        }
+        else {
+            found = bank.transferBetweenAccounts(depositorID, resolveAccount(op.destination, sessionIDs), amount);
+            stats.transfers += found;
+        }
+        if (!found) {
+            ++stats.unknownAccounts;
+        }
+        return;
+    }
+    case WorkloadOp::Type::Total:
+    case WorkloadOp::Type::List:
+        // Reads can throw: a Fixed account's displayed amount is rejected once its balance exceeds the cap
+        try {
+            if (op.type == WorkloadOp::Type::Total) {
+                bank.calculateTotalDeposits();
+            }
+            else {
+                bank.listDepositors();
+            }
+            ++stats.reads;
+        }
+        catch (const InvalidInputException&) {
+            ++stats.failedReads;
+        }
+        return;
+    case WorkloadOp::Type::Stats:
+        printOperationStats(std::cout);
+        return;
+    case WorkloadOp::Type::History: {
+        std::vector<Transaction> transactions;
+        if (bank.recentTransactions(resolveAccount(op.target, sessionIDs), static_cast<size_t>(std::stod(op.amount)), transactions)) {
+            printTransactions(transactions, std::cout);
+            ++stats.reads;
+        }
+        else {
+            ++stats.unknownAccounts;
+        }
+        return;
+    }
+    case WorkloadOp::Type::BalanceAt: {
+        double balance;
+        if (bank.balanceAt(resolveAccount(op.target, sessionIDs), parseTimestamp(op.timestamp), balance)) {
+            std::cout << "Balance at " << op.timestamp << ": " << balance << "\n";
+            ++stats.reads;
+        }
+        else {
+            ++stats.unknownAccounts;
+        }
+        return;
+    }
+    case WorkloadOp::Type::Top:
+        printRanking(bank.topK(static_cast<size_t>(std::stod(op.amount))), std::cout);
+        ++stats.reads;
+        return;
+    case WorkloadOp::Type::Range: {
+        std::vector<RankedDepositor> matches = bank.depositorsInRange(op.low, op.high);
+        for (const auto& match : matches) {
+            std::cout << "Depositor ID: " << match.id << ", Name: " << match.name << ", Balance: " << match.balance << "\n";
+        }
+        std::cout << matches.size() << " depositors with balance between " << op.low << " and " << op.high << "\n";
+        ++stats.reads;
+        return;
+    }
+    case WorkloadOp::Type::Count:
+        std::cout << bank.countInRange(op.low, op.high) << " depositors with balance between " << op.low
+            << " and " << op.high << "\n";
+        ++stats.reads;
+        return;
+    case WorkloadOp::Type::Bottom:
+        try {
+            double held = bank.totalHeldByBottom(op.low);
+            std::cout << "Bottom " << op.low << "% of depositors hold about: " << held << "\n";
+            ++stats.reads;
+        }
+        catch (const InvalidInputException& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            ++stats.failedReads;
+        }
+        return;
+    case WorkloadOp::Type::Percentile: {
+        double percentile;
+        if (bank.percentileRank(resolveAccount(op.target, sessionIDs), percentile)) {
+            std::cout << "Percentile rank: " << percentile << "\n";
+            ++stats.reads;
+        }
+        else {
+            ++stats.unknownAccounts;
+        }
+        return;
+    }
+    case WorkloadOp::Type::Groups:
+        printStrategySummaries(bank.strategySummaries(), std::cout);
+        ++stats.reads;
+        return;
+    case WorkloadOp::Type::Tag:
+        if (!bank.tagDepositor(resolveAccount(op.target, sessionIDs), op.tag)) {
+            ++stats.unknownAccounts;
+        }
+        return;
+    case WorkloadOp::Type::Find:
+    case WorkloadOp::Type::Search: {
+        std::vector<RankedDepositor> matches = bank.searchNames(op.name, op.type == WorkloadOp::Type::Search,
+            static_cast<size_t>(std::stod(op.amount)));
+        for (const auto& match : matches) {
+            std::cout << "Depositor ID: " << match.id << ", Name: " << match.name << ", Balance: " << match.balance << "\n";
+        }
+        std::cout << matches.size() << " depositors found\n";
+        ++stats.reads;
+        return;
+    }
+    case WorkloadOp::Type::Fuzzy:
+        try {
+            std::vector<NameMatch> matches = bank.similarNames(op.name, static_cast<int>(std::stod(op.tag)),
+                static_cast<size_t>(std::stod(op.amount)));
+            printNameMatches(matches, std::cout);
+            ++stats.reads;
+        }
+        catch (const InvalidInputException& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            ++stats.failedReads;
+        }
+        return;
+    case WorkloadOp::Type::Interest:
+        try {
+            std::vector<std::pair<std::string, long long>> rates(op.terms.size());
+            for (size_t i = 0; i < op.terms.size(); ++i) {
+                parseInterestRate(op.terms[i], rates[i]);
+            }
+            AccrualResult result = bank.accrueInterest(rates, static_cast<unsigned>(std::stod(op.amount)));
+            std::cout << "Interest of " << result.credited << " paid to " << result.accounts << " accounts\n";
+        }
+        catch (const InvalidInputException& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+        }
+        return;
+    case WorkloadOp::Type::DepositMany: {
+        std::vector<std::pair<std::string, double>> deposits;
+        for (const auto& term : op.terms) {
+            size_t colon = term.rfind(':');
+            std::string amount = term.substr(colon + 1);
+            if (!isNumeric(amount) || std::stod(amount) < 0) {
+                ++stats.rejectedAmounts;
+                continue;
+            }
+            deposits.push_back({ resolveAccount(term.substr(0, colon), sessionIDs), std::stod(amount) });
+        }
+        DepositBatchResult result = bank.depositMany(deposits);
+        stats.deposits += result.applied + result.rejected;
+        stats.unknownAccounts += result.unknownAccounts;
+        return;
+    }
+    case WorkloadOp::Type::Configure:
+        try {
+            std::string rules;
+            for (const auto& term : op.terms) {
+                rules += term + " ";
+            }
+            configureStrategy(op.strategy, rules);
+            std::cout << "Strategy " << op.strategy << " reconfigured\n";
+        }
+        catch (const InvalidInputException& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+        }
+        return;
+    case WorkloadOp::Type::Filter: {
+        FilterResult result = bank.filterDepositors(op.terms);
+        std::cout << result.count << " depositors match, total balance: " << result.total << "\n";
+        ++stats.reads;
+        return;
+    }
+    case WorkloadOp::Type::Advance:
+        // Only a simulated clock can be moved; with the wall clock the command is ignored
+        if (auto* simulated = dynamic_cast<SimulatedClock*>(&bank.clock())) {
+            simulated->advance(static_cast<long long>(std::stod(op.amount) * 1e9));
+        }
+        else {
+            std::cerr << "advance ignored: the bank uses the system clock (run with --deterministic)\n";
+        }
+        return;
+    }
+}
+
+// Function to print replay counters
+void printWorkloadStats(const WorkloadStats& stats, std::ostream& os) {
+    os << "adds: " << stats.adds << ", deposits: " << stats.deposits << ", withdrawals: " << stats.withdrawals
+        << ", transfers: " << stats.transfers << ", reads: " << stats.reads
+        << ", rejected names: " << stats.rejectedNames << ", rejected amounts: " << stats.rejectedAmounts
+        << ", unknown accounts: " << stats.unknownAccounts << ", failed reads: " << stats.failedReads
+        << ", failed commands: " << stats.failedCommands << "\n";
+}
+
+// Batch command mode: executes commands (add/deposit/deposit-many/withdraw/transfer/history/balance-at/top/range/count/bottom/percentile/groups/tag/filter/find/search/fuzzy/interest/configure/total/list/stats/advance) read line by line from a stream
+int runBatch(std::istream& in, Bank& bank) {
+    std::vector<std::string> sessionIDs;
+    WorkloadStats stats;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        WorkloadOp op;
+        try {
+            if (!parseWorkloadOp(line, op)) {
+                continue;
+            }
+        }
+        catch (const InvalidInputException& e) {
+            std::cerr << "Line " << lineNumber << ": " << e.what() << "\n";
+            continue;
+        }
+        if (op.type == WorkloadOp::Type::Total) {
+            try {
+                double total = bank.calculateTotalDeposits();
+                std::cout << "Total deposits: " << total << "\n";
+                ++stats.reads;
+            }
+            catch (const InvalidInputException& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                ++stats.failedReads;
+            }
+            continue;
+        }
+        // A command that fails only skips its own line; the rest of the batch still runs
+        try {
+            applyWorkloadOp(bank, op, sessionIDs, stats);
+        }
+        catch (const InvalidInputException& e) {
+            std::cerr << "Line " << lineNumber << ": " << e.what() << "\n";
+            ++stats.failedCommands;
+        }
+    }
+    printWorkloadStats(stats, std::cerr);
+    return 0;
+}
+
+// Workload mode: generates a seeded workload and either prints it as batch commands or replays it in-process.
+// Usage: lab3 --workload [--seed n] [--accounts n] [--ops n] [--fixed-ratio r] [--zipf s]
+//                        [--invalid-rate r] [--read-ratio r] [--emit file|-]
+int runWorkload(const std::vector<std::string>& args) {
+    WorkloadConfig config;
+    std::string emitPath;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--emit" && i + 1 < args.size()) {
+            emitPath = args[++i];
+            continue;
+        }
+        if (i + 1 >= args.size() || !isNumeric(args[i + 1])) {
+            throw InvalidInputException("Unknown or incomplete workload option: " + args[i]);
+        }
+        double value = std::stod(args[++i]);
+        if (value < 0) {
+            throw InvalidInputException("Workload option " + args[i - 1] + " cannot be negative");
+        }
+        if (args[i - 1] == "--seed") config.seed = static_cast<unsigned long long>(value);
+        else if (args[i - 1] == "--accounts") config.accounts = static_cast<size_t>(value);
+        else if (args[i - 1] == "--ops") config.operations = static_cast<size_t>(value);
+        else if (args[i - 1] == "--fixed-ratio") config.fixedRatio = value;
+        else if (args[i - 1] == "--zipf") config.zipfSkew = value;
+        else if (args[i - 1] == "--invalid-rate") config.invalidRate = value;
+        else if (args[i - 1] == "--read-ratio") config.readRatio = value;
+        else throw InvalidInputException("Unknown workload option: " + args[i - 1]);
+    }
+    checkAccountCount(config.accounts);
+
+    std::vector<WorkloadOp> ops = generateWorkload(config);
+    if (!emitPath.empty()) {
+        std::ofstream file;
+        if (emitPath != "-") {
+            file.open(emitPath);
+            if (!file) {
+                throw InvalidInputException("Cannot open workload output file: " + emitPath);
+            }
+        }
+        std::ostream& os = emitPath == "-" ? std::cout : file;
+        for (const auto& op : ops) {
+            os << formatWorkloadOp(op) << "\n";
+        }
+        return 0;
+    }
+
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    Bank bank(nullStream, nullStream, makeBankOptions());
+    auto metricsServer = startMetricsServer(bank);
+    std::vector<std::string> sessionIDs;
+    WorkloadStats stats;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& op : ops) {
+        applyWorkloadOp(bank, op, sessionIDs, stats);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << ops.size() << " operations in " << elapsed << " s ("
+        << ops.size() / elapsed << " ops/sec)\n";
+    printWorkloadStats(stats, std::cout);
+    return 0;
+}
+
+// Measurements of one mode at one thread count
+struct ScalingResult {
+    ConcurrencyMode mode;
+    unsigned threads;
+    double opsPerSec;
+    unsigned long long p50, p99, p999;
+    std::vector<LockStats> locks;
+};
+
+// Function to run operation(gen) on the given number of threads for the given time and collect
+// throughput, latency percentiles and the bank's lock contention
+template <typename Operation>
+ScalingResult runConcurrentLoad(const Bank& bank, unsigned threads, double seconds, unsigned long long seed,
+    Operation operation) {
+    std::atomic<bool> running{ true };
+    std::atomic<unsigned long long> operations{ 0 };
+    std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        histograms.push_back(std::make_unique<LatencyHistogram>());
+        LatencyHistogram& histogram = *histograms.back();
+        workers.emplace_back([&, t] {
+            std::mt19937_64 gen(seed * 7919 + t);
+            unsigned long long done = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                auto start = std::chrono::steady_clock::now();
+                operation(gen);
+                histogram.record(static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count()));
+                ++done;
+            }
+            operations.fetch_add(done);
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running.store(false);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LatencyHistogram merged;
+    for (const auto& histogram : histograms) {
+        merged.merge(*histogram);
+    }
+    return { bank.concurrencyMode(), threads, operations.load() / elapsed, merged.percentile(0.5),
+        merged.percentile(0.99), merged.percentile(0.999), bank.lockStats() };
+}
+
+// Function to build a quiet bank of the given mode with numbered depositors (alternating Normal/Fixed).
+// A bare bank keeps neither history nor the balance indexes, so only the mode's own locking is measured.
+std::unique_ptr<Bank> makeLoadBank(ConcurrencyMode mode, size_t accounts, std::vector<std::string>& ids, bool bare) {
+    static const NormalDeposit normal;
+    static const FixedDeposit fixed;
+    BankOptions options = makeBankOptions();
+    options.concurrency = mode;
+    options.printMessages = false;
+    options.recordHistory = !bare;
+    options.indexBalances = !bare;
+    options.enforceDepositLimits = false; // No strategy here has limits; keeps the modes' locking as they define it
+    auto bank = std::make_unique<Bank>(std::cout, std::cerr, options);
+    ids.clear();
+    for (size_t i = 0; i < accounts; ++i) {
+        ids.push_back(bank->addDepositor("Depositor", i % 2 ? static_cast<const IDeposit*>(&fixed) : &normal));
+    }
+    return bank;
+}
+
+// Function to print the header of a scaling table
+void printScalingHeader(std::ostream& os) {
+    os << std::left << std::setw(24) << "mode" << std::right << std::setw(8) << "threads"
+        << std::setw(14) << "ops/sec" << std::setw(10) << "speedup" << std::setw(12) << "efficiency"
+        << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns" << std::setw(11) << "p99.9 ns"
+        << "   lock wait ms (contended/acquired)\n";
+}
+
+// Function to print one scaling row; speedup and efficiency are relative to the single-thread throughput
+void printScalingRow(const std::string& label, const ScalingResult& r, double baseline, std::ostream& os) {
+    double speedup = baseline > 0 ? r.opsPerSec / baseline : 0;
+    os << std::fixed << std::left << std::setw(24) << label << std::right
+        << std::setw(8) << r.threads << std::setw(14) << std::setprecision(0) << r.opsPerSec
+        << std::setw(10) << std::setprecision(2) << speedup
+        << std::setw(11) << std::setprecision(1) << speedup / r.threads * 100 << "%"
+        << std::setw(10) << r.p50 << std::setw(10) << r.p99 << std::setw(11) << r.p999 << "  ";
+    for (const auto& lock : r.locks) {
+        if (lock.acquisitions > 0) {
+            os << " " << lock.name << "=" << std::setprecision(2) << lock.waitSeconds * 1000
+                << " (" << lock.contended << "/" << lock.acquisitions << ")";
+        }
+    }
+    os << std::defaultfloat << "\n";
+}
+
+// Function to list the thread counts 1, 2, 4, ... up to and including maxThreads
+std::vector<unsigned> threadCountsUpTo(unsigned maxThreads) {
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < maxThreads; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+const ConcurrencyMode allConcurrencyModes[] = { ConcurrencyMode::GlobalLock, ConcurrencyMode::Sharded, ConcurrencyMode::LockFree };
+
+// Options shared by the concurrent load modes
+struct LoadConfig {
+    unsigned maxThreads = std::max(4u, std::thread::hardware_concurrency());
+    double seconds = 1.0;
+    size_t hotAccounts = 16; // Transfers: size of the hot set
+    double addRatio = 0.01;  // Scaling: fraction of operations that add a depositor
+    WorkloadConfig workload;
+};
+
+// Function to parse "--name value" pairs shared by the concurrent load modes
+LoadConfig parseLoadOptions(const std::vector<std::string>& args, const std::string& mode) {
+    LoadConfig config;
+    config.workload.accounts = 10000;
+    config.workload.readRatio = 0.001;
+    for (size_t i = 0; i < args.size(); i += 2) {
+        if (i + 1 >= args.size() || !isNumeric(args[i + 1]) || std::stod(args[i + 1]) < 0) {
+            throw InvalidInputException("Unknown or incomplete " + mode + " option: " + args[i]);
+        }
+        double value = std::stod(args[i + 1]);
+        if (args[i] == "--threads") config.maxThreads = std::max(1u, static_cast<unsigned>(value));
+        else if (args[i] == "--accounts") config.workload.accounts = std::max<size_t>(2, static_cast<size_t>(value));
+        else if (args[i] == "--seconds") config.seconds = value;
+        else if (args[i] == "--zipf") config.workload.zipfSkew = value;
+        else if (args[i] == "--read-ratio") config.workload.readRatio = value;
+        else if (args[i] == "--add-ratio") config.addRatio = value;
+        else if (args[i] == "--hot-accounts") config.hotAccounts = std::max<size_t>(2, static_cast<size_t>(value));
+        else if (args[i] == "--seed") config.workload.seed = static_cast<unsigned long long>(value);
+        else throw InvalidInputException("Unknown " + mode + " option: " + args[i]);
+    }
+    checkAccountCount(config.workload.accounts);
+    return config;
+}
+
+// Thread-scaling mode: runs a mixed workload at 1..N threads for each concurrency mode and prints
+// throughput, tail latency, lock contention and scaling efficiency (speedup / threads). Each mode runs
+// with history and the balance indexes kept, then bare (neither kept), where only its own locking counts.
+// Usage: lab3 --scaling [--threads n] [--accounts n] [--seconds s] [--zipf s] [--read-ratio r] [--add-ratio r] [--seed n]
+int runScaling(const std::vector<std::string>& args) {
+    static const NormalDeposit normal;
+    LoadConfig config = parseLoadOptions(args, "scaling");
+    const WorkloadConfig& workload = config.workload;
+    ZipfDistribution zipf(workload.accounts, workload.zipfSkew);
+
+    printScalingHeader(std::cout);
+    for (ConcurrencyMode mode : allConcurrencyModes) {
+        for (bool bare : { false, true }) {
+            double baseline = 0;
+            for (unsigned threads : threadCountsUpTo(config.maxThreads)) {
+                std::vector<std::string> ids;
+                auto bank = makeLoadBank(mode, workload.accounts, ids, bare);
+                ScalingResult r = runConcurrentLoad(*bank, threads, config.seconds, workload.seed, [&](std::mt19937_64& gen) {
+                    double roll = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+                    if (roll < workload.readRatio) {
+                        try {
+                            bank->calculateTotalDeposits();
+                        }
+                        catch (const InvalidInputException&) {
+                            // A Fixed account above the cap; the read still counts
+                        }
+                    }
+                    else if (roll < workload.readRatio + config.addRatio) {
+                        try {
+                            bank->addDepositor("Depositor", &normal);
+                        }
+                        catch (const InvalidInputException&) {
+                            // Every depositor ID is taken; the attempt still counts
+                        }
+                    }
+                    else {
+                        bank->depositToAccount(ids[zipf(gen)], 10);
+                    }
+                });
+                baseline = threads == 1 ? r.opsPerSec : baseline;
+                printScalingRow(std::string(concurrencyModeName(mode)) + (bare ? " bare" : ""), r, baseline, std::cout);
+            }
+        }
+    }
+    return 0;
+}
+
+// Transfer benchmark: moves money between random account pairs and between pairs drawn from a small
+// hot set, at 1..N threads for each concurrency mode, with history and the balance indexes kept and bare.
+// Usage: lab3 --transfers [--threads n] [--accounts n] [--hot-accounts k] [--seconds s] [--seed n]
+int runTransferBenchmark(const std::vector<std::string>& args) {
+    LoadConfig config = parseLoadOptions(args, "transfer");
+    size_t accounts = config.workload.accounts;
+    size_t hot = std::min(config.hotAccounts, accounts);
+
+    printScalingHeader(std::cout);
+    for (ConcurrencyMode mode : allConcurrencyModes) {
+        for (bool bare : { false, true }) {
+            for (bool hotPairs : { false, true }) {
+                double baseline = 0;
+                for (unsigned threads : threadCountsUpTo(config.maxThreads)) {
+                    std::vector<std::string> ids;
+                    auto bank = makeLoadBank(mode, accounts, ids, bare);
+                    for (const auto& id : ids) {
+                        bank->depositToAccount(id, 100000); // Enough that 1-unit transfers never run dry
+                    }
+                    size_t range = hotPairs ? hot : accounts;
+                    ScalingResult r = runConcurrentLoad(*bank, threads, config.seconds, config.workload.seed,
+                        [&](std::mt19937_64& gen) {
+                            std::uniform_int_distribution<size_t> pick(0, range - 1);
+                            size_t from = pick(gen);
+                            size_t to = pick(gen);
+                            if (to == from) {
+                                to = (to + 1) % range;
+                            }
+                            bank->transferBetweenAccounts(ids[from], ids[to], 1);
+                        });
+                    baseline = threads == 1 ? r.opsPerSec : baseline;
+                    printScalingRow(std::string(concurrencyModeName(mode)) + (bare ? " bare" : "") + (hotPairs ? " hot" : " random"),
+                        r, baseline, std::cout);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to read the resident set size of this process in bytes (0 where unsupported)
+size_t residentMemoryBytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+// One configuration of the footprint comparison
+struct FootprintRow {
+    std::string configuration;
+    double readySeconds;
+    size_t residentBytes;
+    MemoryFootprint footprint;
+};
+
+// Function to build a bank of the given size, make the given number of deposits per account and
+// measure its footprint and time-to-ready
+FootprintRow measureFootprint(const std::string& configuration, BankOptions options, size_t accounts, size_t depositsPerAccount) {
+    static const NormalDeposit normal;
+    static const FixedDeposit fixed;
+    std::mt19937_64 gen(accounts);
+    std::vector<std::string> names(std::min<size_t>(accounts, 4096));
+    for (auto& name : names) {
+        name = generateName(gen);
+    }
+    options.printMessages = false;
+    size_t residentBefore = residentMemoryBytes();
+    auto start = std::chrono::steady_clock::now();
+    Bank bank(std::cout, std::cerr, options);
+    for (size_t i = 0; i < accounts; ++i) {
+        std::string id = bank.addDepositor(names[i % names.size()], i % 2 ? static_cast<const IDeposit*>(&fixed) : &normal);
+        for (size_t k = 0; k < depositsPerAccount; ++k) {
+            bank.depositToAccount(id, 100);
+        }
+    }
+    FootprintRow row;
+    row.configuration = configuration;
+    row.readySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t residentAfter = residentMemoryBytes();
+    row.residentBytes = residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+    row.footprint = bank.memoryFootprint();
+    return row;
+}
+
+// Function to print one footprint row; byte columns are per depositor
+void printFootprintRow(const FootprintRow& row, size_t accounts, std::ostream& os) {
+    double n = double(accounts);
+    const MemoryFootprint& f = row.footprint;
+    os << std::fixed << std::left << std::setw(14) << row.configuration << std::right
+        << std::setw(10) << accounts << std::setw(10) << std::setprecision(3) << row.readySeconds
+        << std::setw(10) << std::setprecision(1) << row.residentBytes / 1048576.0
+        << std::setw(10) << row.residentBytes / n
+        << std::setw(10) << f.records / n << std::setw(10) << f.names / n << std::setw(10) << f.indexes / n
+        << std::setw(10) << f.history / n << std::setw(10) << f.fixed / n << std::setw(10) << f.total() / n
+        << std::defaultfloat << "\n";
+}
+
+// Footprint mode: builds banks of N accounts and reports resident memory, bytes per depositor by
+// structure and time-to-ready for each storage configuration.
+// Usage: lab3 --footprint [--accounts 1000,100000,...] [--deposits-per-account n]
+int runFootprint(const std::vector<std::string>& args) {
+    std::vector<size_t> sizes = { 1000, 100000, 500000 };
+    size_t depositsPerAccount = 4;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--accounts" && i + 1 < args.size()) {
+            sizes = parseSizeList(args[++i]);
+            for (size_t size : sizes) {
+                checkAccountCount(size);
+            }
+        }
+        else if (args[i] == "--deposits-per-account" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            depositsPerAccount = static_cast<size_t>(std::stod(args[++i]));
+        }
+        else {
+            throw InvalidInputException("Unknown footprint option: " + args[i]);
+        }
+    }
+
+    std::vector<std::pair<std::string, BankOptions>> configurations;
+    for (ConcurrencyMode mode : { ConcurrencyMode::GlobalLock, ConcurrencyMode::Sharded, ConcurrencyMode::LockFree }) {
+        BankOptions options = makeBankOptions();
+        options.concurrency = mode;
+        configurations.emplace_back(concurrencyModeName(mode), options);
+    }
+    BankOptions withoutHistory = makeBankOptions();
+    withoutHistory.concurrency = ConcurrencyMode::LockFree;
+    withoutHistory.recordHistory = false;
+    configurations.emplace_back("no-history", withoutHistory);
+
+    std::cout << depositsPerAccount << " deposits per account\n";
+    std::cout << std::left << std::setw(14) << "storage" << std::right << std::setw(10) << "accounts"
+        << std::setw(10) << "ready s" << std::setw(10) << "RSS MB" << std::setw(10) << "RSS B/d"
+        << std::setw(10) << "records" << std::setw(10) << "names" << std::setw(10) << "indexes"
+        << std::setw(10) << "history" << std::setw(10) << "fixed" << std::setw(10) << "total B/d" << "\n";
+    std::cout.flush();
+    for (size_t accounts : sizes) {
+        for (const auto& configuration : configurations) {
+#if defined(__unix__) || defined(__APPLE__)
+            // Each configuration is built in a child process so freed memory of the previous one
+            // cannot hide in this process's resident set
+            pid_t child = fork();
+            if (child == 0) {
+                printFootprintRow(measureFootprint(configuration.first, configuration.second, accounts, depositsPerAccount), accounts, std::cout);
+                std::cout.flush();
+                _exit(0);
+            }
+            if (child > 0) {
+                int status = 0;
+                waitpid(child, &status, 0);
+                continue;
+            }
+#endif
+            printFootprintRow(measureFootprint(configuration.first, configuration.second, accounts, depositsPerAccount), accounts, std::cout);
+        }
+    }
+    return 0;
+}
+
+// Interest mode: builds a bank of N accounts with a spread of balances, then applies interest over many
+// periods with 1, 2, 4, ... threads and reports the accrual pass and the index update separately.
+// Usage: lab3 --interest [--accounts n] [--periods n] [--threads max] [--history] [--no-index]
+int runInterestBenchmark(const std::vector<std::string>& args) {
+    size_t accounts = 500000;
+    unsigned periods = 12;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    BankOptions options = makeBankOptions();
+    options.concurrency = ConcurrencyMode::LockFree;
+    options.printMessages = false;
+    options.recordHistory = false;
+    options.enforceDepositLimits = false;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--accounts" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            accounts = static_cast<size_t>(std::stod(args[++i]));
+            checkAccountCount(accounts);
+        }
+        else if (args[i] == "--periods" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            double value = std::stod(args[++i]);
+            if (!(value >= 0 && value <= Bank::kMaxInterestPeriods)) {
+                throw InvalidInputException("--periods must be between 0 and " + std::to_string(Bank::kMaxInterestPeriods));
+            }
+            periods = static_cast<unsigned>(value);
+        }
+        else if (args[i] == "--threads" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            maxThreads = std::max(1u, static_cast<unsigned>(std::stod(args[++i])));
+        }
+        else if (args[i] == "--history") {
+            options.recordHistory = true;
+        }
+        else if (args[i] == "--no-index") {
+            options.indexBalances = false;
+        }
+        else {
+            throw InvalidInputException("Unknown interest option: " + args[i]);
+        }
+    }
+
+    static const NormalDeposit normal;
+    static const FixedDeposit fixed;
+    auto start = std::chrono::steady_clock::now();
+    Bank bank(std::cout, std::cerr, options);
+    for (size_t i = 0; i < accounts; ++i) {
+        std::string id = bank.addDepositor("Depositor", i % 2 ? static_cast<const IDeposit*>(&fixed) : &normal);
+        bank.depositToAccount(id, double(i % 100000) + 0.37);
+    }
+    double setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << accounts << " accounts ready in " << std::fixed << std::setprecision(2) << setupSeconds
+        << " s, " << periods << " periods per pass\n";
+
+    std::vector<std::pair<std::string, long long>> rates = { { "Normal", 4167 }, { "Fixed", 2500 } }; // 5% and 3% a year, monthly
+    std::cout << std::right << std::setw(8) << "threads" << std::setw(12) << "accrual s" << std::setw(16) << "ns/acct-period"
+        << std::setw(10) << "speedup" << std::setw(10) << "index s" << std::setw(18) << "credited" << "\n";
+    double baseline = 0;
+    for (unsigned threads : threadCountsUpTo(maxThreads)) {
+        AccrualResult r = bank.accrueInterest(rates, periods, threads);
+        if (baseline == 0) {
+            baseline = r.seconds;
+        }
+        std::cout << std::setw(8) << threads << std::setw(12) << std::setprecision(3) << r.seconds
+            << std::setw(16) << std::setprecision(2) << r.seconds * 1e9 / (double(accounts) * std::max(1u, periods))
+            << std::setw(10) << (r.seconds > 0 ? baseline / r.seconds : 0)
+            << std::setw(10) << std::setprecision(3) << r.indexSeconds
+            << std::setw(18) << std::setprecision(2) << r.credited << "\n";
+    }
+    std::cout << std::defaultfloat;
+    return 0;
+}
+
+// Reload mode: deposits into Fixed accounts on 1, 2, 4, ... threads, first with fixed terms and then
+// while another thread republishes the Fixed cap every few hundred microseconds, to show that
+// reconfiguring does not stall deposits.
+// Usage: lab3 --reload [--threads n] [--accounts n] [--seconds s] [--interval-us n]
+int runReloadBenchmark(const std::vector<std::string>& args) {
+    unsigned maxThreads = std::max(4u, std::thread::hardware_concurrency());
+    size_t accounts = 10000;
+    double seconds = 1.0;
+    long long intervalMicros = 200;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--threads" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            maxThreads = std::max(1u, static_cast<unsigned>(std::stod(args[++i])));
+        }
+        else if (args[i] == "--accounts" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            accounts = std::max<size_t>(1, static_cast<size_t>(std::stod(args[++i])));
+            checkAccountCount(accounts);
+        }
+        else if (args[i] == "--seconds" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            seconds = std::stod(args[++i]);
+        }
+        else if (args[i] == "--interval-us" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            intervalMicros = static_cast<long long>(std::stod(args[++i]));
+        }
+        else {
+            throw InvalidInputException("Unknown reload option: " + args[i]);
+        }
+    }
+
+    static const FixedDeposit fixed;
+    printScalingHeader(std::cout);
+    for (unsigned threads : threadCountsUpTo(maxThreads)) {
+        double baseline = 0;
+        for (bool reloading : { false, true }) {
+            BankOptions options = makeBankOptions();
+            options.concurrency = ConcurrencyMode::LockFree;
+            options.printMessages = false;
+            options.recordHistory = false;
+            options.indexBalances = false;
+            options.enforceDepositLimits = false;
+            Bank bank(std::cout, std::cerr, options);
+            std::vector<std::string> ids;
+            for (size_t i = 0; i < accounts; ++i) {
+                ids.push_back(bank.addDepositor("Depositor", &fixed));
+            }
+
+            std::atomic<bool> running{ reloading };
+            unsigned long long reloads = 0;
+            std::thread reloader([&] {
+                while (running.load()) {
+                    auto terms = std::make_unique<FixedDepositTerms>();
+                    terms->cap = reloads % 2 ? 1000000 : 2000000;
+                    FixedDeposit::terms().publish(std::move(terms));
+                    ++reloads;
+                    std::this_thread::sleep_for(std::chrono::microseconds(intervalMicros));
+                }
+            });
+            ScalingResult r = runConcurrentLoad(bank, threads, seconds, 1, [&](std::mt19937_64& gen) {
+                bank.depositToAccount(ids[gen() % ids.size()], 10);
+            });
+            running.store(false);
+            reloader.join();
+            FixedDeposit::terms().publish(std::make_unique<FixedDepositTerms>());
+
+            if (baseline == 0) {
+                baseline = r.opsPerSec;
+            }
+            printScalingRow(reloading ? "reloading (" + std::to_string(reloads) + ")" : "fixed terms", r, baseline, std::cout);
+        }
+    }
+    return 0;
+}
+
+// Function to compute the edit distance between two strings with the textbook dynamic programming table,
+// the reference the self-test holds NameIndex's bit-parallel search to
+int referenceEditDistance(const std::string& a, const std::string& b) {
+    std::vector<int> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) {
+        row[j] = static_cast<int>(j);
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+        int diagonal = row[0];
+        row[0] = static_cast<int>(i);
+        for (size_t j = 1; j <= b.size(); ++j) {
+            int above = row[j];
+            row[j] = std::min({ row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1]) });
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+// Self-test: replays seeded deposits, withdrawals and transfers and checks every account's history,
+// last-N query and point-in-time balances against a plain list of the changes made. Returns the first
+// mismatch, or an empty string.
+std::string checkTransactionHistory(ConcurrencyMode mode, unsigned long long seed) {
+    BankOptions options;
+    options.concurrency = mode;
+    options.printMessages = false;
+    options.checkpointInterval = 8;
+    options.clock = std::make_shared<SimulatedClock>();
+    options.random = std::make_shared<MersenneRandom>(seed);
+    Bank bank(std::cout, std::cerr, options);
+    NormalDeposit normal;
+    const size_t accounts = 16;
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < accounts; ++i) {
+        ids.push_back(bank.addDepositor("Depositor", &normal));
+    }
+
+    // Whole amounts keep every balance exact, so the comparisons below need no tolerance
+    std::mt19937_64 gen(seed);
+    std::vector<std::vector<double>> changes(accounts);
+    std::vector<double> balances(accounts, 0);
+    for (int op = 0; op < 4000; ++op) {
+        size_t from = gen() % accounts;
+        double amount = double(1 + gen() % 500);
+        switch (gen() % 3) {
+        case 0:
+            bank.depositToAccount(ids[from], amount);
+            changes[from].push_back(amount);
+            balances[from] += amount;
+            break;
+        case 1:
+            bank.withdrawFromAccount(ids[from], amount);
+            if (balances[from] >= amount) {
+                changes[from].push_back(-amount);
+                balances[from] -= amount;
+            }
+            break;
+        default: {
+            size_t to = (from + 1 + gen() % (accounts - 1)) % accounts;
+            bank.transferBetweenAccounts(ids[from], ids[to], amount);
+            if (balances[from] >= amount) {
+                changes[from].push_back(-amount);
+                changes[to].push_back(amount);
+                balances[from] -= amount;
+                balances[to] += amount;
+            }
+            break;
+        }
+        }
+    }
 
-// Function to check if a string contains only alphabetic characters
-bool isValidName(const std::string& name) {
-    for (char c : name) {
-        if (!std::isalpha(c)) {
-            return false;
+    for (size_t i = 0; i < accounts; ++i) {
+        std::vector<Transaction> history;
+        bank.recentTransactions(ids[i], changes[i].size() + 1, history);
+        if (history.size() != changes[i].size()) {
+            return ids[i] + " has " + std::to_string(history.size()) + " transactions, expected " + std::to_string(changes[i].size());
+        }
+        // history is newest first; walk the reference from the oldest change up
+        double balance = 0;
+        long long previousTimestamp = std::numeric_limits<long long>::min();
+        for (size_t k = 0; k < changes[i].size(); ++k) {
+            const Transaction& t = history[history.size() - 1 - k];
+            balance += changes[i][k];
+            if (t.amount != changes[i][k] || t.balanceAfter != balance || t.sequence != k + 1) {
+                return ids[i] + " transaction " + std::to_string(k + 1) + " does not match the reference";
+            }
+            if (t.timestampNs <= previousTimestamp) {
+                return ids[i] + " transactions are not in time order";
+            }
+            double before, after;
+            bank.balanceAt(ids[i], t.timestampNs - 1, before);
+            bank.balanceAt(ids[i], t.timestampNs, after);
+            if (before != balance - changes[i][k] || after != balance) {
+                return ids[i] + " balance at transaction " + std::to_string(k + 1) + " does not match the reference";
+            }
+            previousTimestamp = t.timestampNs;
+        }
+        std::vector<Transaction> latest;
+        bank.recentTransactions(ids[i], 5, latest);
+        if (latest.size() != std::min<size_t>(5, history.size()) || !std::equal(latest.begin(), latest.end(), history.begin(),
+            [](const Transaction& a, const Transaction& b) { return a.sequence == b.sequence; })) {
+            return ids[i] + " last 5 transactions do not match the full history";
         }
     }
-    return true;
-}
-
-// Function to check if the input is numeric
-bool isNumeric(const std::string& str) {
-    char* end = nullptr;
-    std::strtod(str.c_str(), &end);
-    return end != str.c_str() && *end == '\0'; // Ensure the whole string is a number
+    return "";
 }
 
-// Function to generate a random 6-digit number
-std::string generateRandomID() {
-    std::random_device rd;  // Seed for the random number generator
-    std::mt19937 gen(rd()); // Standard mersenne_twister_engine
-    std::uniform_int_distribution<> dist(100000, 999999); // Range for six-digit number
+// Self-test: batches through depositMany that name the same account several times, mixed with single
+// deposits, checked against a plain total per account through the balance index and the history
+std::string checkDepositMany(ConcurrencyMode mode, unsigned long long seed) {
+    BankOptions options;
+    options.concurrency = mode;
+    options.printMessages = false;
+    options.clock = std::make_shared<SimulatedClock>();
+    options.random = std::make_shared<MersenneRandom>(seed);
+    Bank bank(std::cout, std::cerr, options);
+    NormalDeposit normal;
+    const size_t accounts = 8;
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < accounts; ++i) {
+        ids.push_back(bank.addDepositor("Depositor", &normal));
+    }
+    std::mt19937_64 gen(seed);
+    std::vector<double> balances(accounts, 0);
+    std::vector<size_t> deposits(accounts, 0);
+    for (int round = 0; round < 200; ++round) {
+        std::vector<std::pair<std::string, double>> batch(1 + gen() % 12);
+        for (auto& deposit : batch) {
+            size_t account = gen() % accounts;
+            deposit = { ids[account], double(1 + gen() % 500) };
+            balances[account] += deposit.second;
+            ++deposits[account];
+        }
+        bank.depositMany(batch);
+        size_t single = gen() % accounts;
+        bank.depositToAccount(ids[single], 10);
+        balances[single] += 10;
+        ++deposits[single];
+    }
 
-    std::stringstream ss;
-    ss << "PZ" << dist(gen); // Combine "PZ" with the random number
-    return ss.str();
+    if (bank.countInRange(-1e18, 1e18) != accounts) {
+        return "the balance index holds " + std::to_string(bank.countInRange(-1e18, 1e18)) + " entries for "
+            + std::to_string(accounts) + " accounts";
+    }
+    std::vector<RankedDepositor> ranking = bank.topK(accounts + 1);
+    std::set<std::string> seen;
+    for (const auto& ranked : ranking) {
+        size_t account = static_cast<size_t>(std::find(ids.begin(), ids.end(), ranked.id) - ids.begin());
+        if (!seen.insert(ranked.id).second) {
+            return ranked.id + " is ranked twice";
+        }
+        if (account == accounts || ranked.balance != balances[account]) {
+            return ranked.id + " is ranked at " + std::to_string(ranked.balance) + ", expected "
+                + (account == accounts ? std::string("no such account") : std::to_string(balances[account]));
+        }
+    }
+    for (size_t i = 0; i < accounts; ++i) {
+        std::vector<Transaction> history;
+        bank.recentTransactions(ids[i], deposits[i] + 1, history);
+        if (history.size() != deposits[i] || (!history.empty() && history[0].balanceAfter != balances[i])) {
+            return ids[i] + " history does not match its deposits";
+        }
+        for (size_t k = 1; k < history.size(); ++k) {
+            if (history[k].timestampNs > history[k - 1].timestampNs) {
+                return ids[i] + " transactions are not in time order";
+            }
+        }
+    }
+    return "";
 }
 
-// Depositor class to hold information about a depositor
-class Depositor {
-private:
-    std::string name;
-    double amount;
-    const IDeposit* depositStrategy;
-    std::string depositorID; // String for ID in format PZxxxxxx
-
-public:
-    Depositor(const std::string& id, const std::string& name, double amount, const IDeposit* strategy)
-        : depositorID(id), name(name), amount(amount), depositStrategy(strategy) {}
+// Self-test: random inserts, updates and erases with many equal balances, checked after every step
+// against a std::set of the same keys
+std::string checkBalanceIndex(unsigned long long seed) {
+    BalanceIndex index;
+    std::set<BalanceIndex::Key> reference;
+    std::vector<double> balances;
+    std::vector<bool> present;
+    std::mt19937_64 gen(seed);
+    for (int op = 0; op < 20000; ++op) {
+        size_t slot = gen() % 2000;
+        if (slot >= balances.size()) {
+            balances.resize(slot + 1, 0);
+            present.resize(slot + 1, false);
+        }
+        double balance = double(gen() % 300);
+        if (!present[slot]) {
+            index.insert(balance, slot);
+            reference.insert({ balance, slot });
+            present[slot] = true;
+        }
+        else if (gen() % 4 == 0) {
+            index.erase(balances[slot], slot);
+            reference.erase({ balances[slot], slot });
+            present[slot] = false;
+        }
+        else {
+            index.update(balances[slot], balance, slot);
+            reference.erase({ balances[slot], slot });
+            reference.insert({ balance, slot });
+        }
+        balances[slot] = balance;
 
-    double getDepositAmount() const {
-        return depositStrategy->calculateDeposit(amount);
+        if (index.size() != reference.size()) {
+            return "size " + std::to_string(index.size()) + ", expected " + std::to_string(reference.size());
+        }
+        if (op % 50 != 0) {
+            continue;
+        }
+        double low = double(gen() % 300);
+        double high = low + double(gen() % 50);
+        size_t inRange = std::distance(reference.lower_bound({ low, 0 }),
+            reference.upper_bound({ high, std::numeric_limits<size_t>::max() }));
+        if (index.countInRange(low, high) != inRange) {
+            return "countInRange(" + std::to_string(low) + ", " + std::to_string(high) + ") is wrong";
+        }
+        std::vector<BalanceIndex::Key> visited;
+        index.forEachInRange(low, high, [&](size_t s, double b) { visited.push_back({ b, s }); });
+        if (!std::equal(visited.begin(), visited.end(), reference.lower_bound({ low, 0 }), reference.upper_bound({ high, std::numeric_limits<size_t>::max() }))) {
+            return "forEachInRange visits the wrong accounts";
+        }
+        BalanceIndex::Key probe{ low, gen() % 2000 };
+        if (index.countBelow(probe) != static_cast<size_t>(std::distance(reference.begin(), reference.lower_bound(probe)))) {
+            return "countBelow is wrong";
+        }
+        visited.clear();
+        index.forEachLargest(10, [&](size_t s, double b) { visited.push_back({ b, s }); });
+        if (visited.size() != std::min<size_t>(10, reference.size()) || !std::equal(visited.begin(), visited.end(), reference.rbegin())) {
+            return "forEachLargest visits the wrong accounts";
+        }
     }
+    return "";
+}
 
-    std::string getName() const {
-        return name;
+// Self-test: prefix totals of the balance distribution against a sorted copy of the balances. The
+// bucket the boundary falls in is estimated, so that part may be off by the bucket's width.
+std::string checkBalanceDistribution(unsigned long long seed) {
+    BalanceDistribution distribution;
+    std::vector<double> balances(5000);
+    std::mt19937_64 gen(seed);
+    std::lognormal_distribution<double> spread(6, 2);
+    for (auto& balance : balances) {
+        balance = std::round(spread(gen) * 100) / 100;
+        distribution.add(balance);
     }
-
-    std::string getID() const {
-        return depositorID;
+    for (int i = 0; i < 2000; ++i) {
+        size_t account = gen() % balances.size();
+        double after = std::round(spread(gen) * 100) / 100;
+        distribution.update(balances[account], after);
+        balances[account] = after;
+    }
+    std::sort(balances.begin(), balances.end());
+    if (distribution.count() != balances.size()) {
+        return "count " + std::to_string(distribution.count()) + ", expected " + std::to_string(balances.size());
+    }
+    double exact = 0;
+    for (size_t accounts = 0; accounts <= balances.size(); ++accounts) {
+        double total = distribution.totalOfSmallest(accounts);
+        // Balances are stored in cents, so even the full total is only exact to a cent per account
+        double tolerance = 0.04 * exact + 0.01 * double(accounts);
+        if (std::abs(total - exact) > tolerance) {
+            return "total of the " + std::to_string(accounts) + " smallest is " + std::to_string(total)
+                + ", expected about " + std::to_string(exact);
+        }
+        if (accounts < balances.size()) {
+            exact += balances[accounts];
+        }
     }
+    return "";
+}
 
-    void deposit(double amount) {
-        validateDepositAmount(amount);
-        this->amount += depositStrategy->calculateDeposit(amount); // Add to the deposit amount using strategy
+// Self-test: bitmaps spread over several containers, one of them dense enough to turn into a bitset,
+// against std::set
+std::string checkRoaringBitmap(unsigned long long seed) {
+    std::mt19937_64 gen(seed);
+    RoaringBitmap a, b;
+    std::set<unsigned int> referenceA, referenceB;
+    auto randomValue = [&] {
+        // Mostly the first container, so it crosses kArrayMaximum; the rest spread over a few more
+        return gen() % 2 ? static_cast<unsigned int>(gen() % 20000) : static_cast<unsigned int>(gen() % 400000);
+    };
+    for (int op = 0; op < 60000; ++op) {
+        unsigned int value = randomValue();
+        bool first = gen() % 2;
+        RoaringBitmap& bitmap = first ? a : b;
+        std::set<unsigned int>& reference = first ? referenceA : referenceB;
+        if (gen() % 5 == 0) {
+            bitmap.remove(value);
+            reference.erase(value);
+        }
+        else {
+            bitmap.add(value);
+            reference.insert(value);
+        }
+        if (bitmap.contains(value) != (reference.count(value) > 0)) {
+            return "contains(" + std::to_string(value) + ") is wrong";
+        }
     }
-};
+    if (a.cardinality() != referenceA.size() || b.cardinality() != referenceB.size()) {
+        return "cardinality is wrong";
+    }
+    std::vector<unsigned int> values;
+    a.forEach([&](unsigned int value) { values.push_back(value); });
+    if (!std::equal(values.begin(), values.end(), referenceA.begin(), referenceA.end())) {
+        return "forEach visits the wrong values";
+    }
+    std::vector<unsigned int> common;
+    std::set_intersection(referenceA.begin(), referenceA.end(), referenceB.begin(), referenceB.end(), std::back_inserter(common));
+    values.clear();
+    RoaringBitmap::intersect(a, b).forEach([&](unsigned int value) { values.push_back(value); });
+    if (values != common) {
+        return "intersect has " + std::to_string(values.size()) + " values, expected " + std::to_string(common.size());
+    }
+    return "";
+}
 
-// Bank class to manage depositors and calculate total deposits
-class Bank {
-private:
-    std::vector<Depositor> depositors;
+// Self-test: prefix, substring and fuzzy name searches over names from a small alphabet (so queries
+// match often) against a scan of the names
+std::string checkNameIndex(unsigned long long seed) {
+    std::mt19937_64 gen(seed);
+    auto randomName = [&](size_t minLength, size_t maxLength) {
+        std::string name(minLength + gen() % (maxLength - minLength + 1), 'a');
+        for (auto& c : name) {
+            c = static_cast<char>("abcdeABC"[gen() % 8]);
+        }
+        return name;
+    };
+    NameIndex index;
+    std::vector<std::string> names;
+    for (size_t slot = 0; slot < 3000; ++slot) {
+        names.push_back(randomName(2, 9));
+        index.add(slot, names.back());
+    }
+    auto lower = [](std::string text) {
+        for (char& c : text) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return text;
+    };
+    for (int query = 0; query < 200; ++query) {
+        std::string text = randomName(1, 6);
+        std::string pattern = lower(text);
 
-public:
-    void addDepositor(const std::string& name, const IDeposit* strategy) {
-        std::string depositorID = generateRandomID(); // Generate a random ID
-        depositors.emplace_back(depositorID, name, 0, strategy); // Add depositor with 0 initial deposit
+        std::vector<size_t> found, expected;
+        index.forEachWithPrefix(text, [&](size_t slot) { found.push_back(slot); return true; });
+        for (size_t slot = 0; slot < names.size(); ++slot) {
+            if (lower(names[slot]).compare(0, pattern.size(), pattern) == 0) {
+                expected.push_back(slot);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        if (found != expected) {
+            return "prefix search for " + text + " finds " + std::to_string(found.size()) + " names, expected " + std::to_string(expected.size());
+        }
 
-        // Print the new depositor's ID immediately after adding
-        std::cout << "Depositor added successfully! User ID: " << depositorID << "\n";
-    }
+        found.clear();
+        expected.clear();
+        index.forEachContaining(text, [&](size_t slot) { found.push_back(slot); return true; });
+        for (size_t slot = 0; slot < names.size(); ++slot) {
+            if (lower(names[slot]).find(pattern) != std::string::npos) {
+                expected.push_back(slot);
+            }
+        }
+        if (found != expected) {
+            return "substring search for " + text + " finds " + std::to_string(found.size()) + " names, expected " + std::to_string(expected.size());
+        }
 
-    bool depositToAccount(const std::string& depositorID, double amount) {
-        for (auto& depositor : depositors) {
-            if (depositor.getID() == depositorID) {
-                try {
-                    depositor.deposit(amount); // Deposit the amount to the found account
-                    std::cout << "Deposit of " << amount << " made to account ID: " << depositorID << "\n";
-                }
-                catch (const InvalidInputException& e) {
-                    std::cerr << "Error: " << e.what() << "\n";
-                }
-                return true;
+        int maxDistance = static_cast<int>(gen() % 3);
+        std::vector<std::pair<size_t, int>> similar, expectedSimilar;
+        index.forEachSimilar(text, maxDistance, 1, [&](size_t slot, int distance) { similar.push_back({ slot, distance }); });
+        for (size_t slot = 0; slot < names.size(); ++slot) {
+            int distance = referenceEditDistance(pattern, lower(names[slot]));
+            if (distance <= maxDistance) {
+                expectedSimilar.push_back({ slot, distance });
             }
         }
-        return false; // If no depositor matches the given ID
+        if (similar != expectedSimilar) {
+            return "fuzzy search for " + text + " within " + std::to_string(maxDistance) + " finds "
+                + std::to_string(similar.size()) + " names, expected " + std::to_string(expectedSimilar.size());
+        }
     }
+    return "";
+}
 
-    double calculateTotalDeposits() const {
-        double total = 0;
-        for (const auto& depositor : depositors) {
-            total += depositor.getDepositAmount();
+// Self-test: the branchless bracket search against the if chain, on every threshold, just below
+// each one and on random amounts
+std::string checkBracketTable(unsigned long long seed) {
+    std::mt19937_64 gen(seed);
+    for (size_t brackets = 0; brackets < BracketTable::kCapacity; ++brackets) {
+        std::vector<std::pair<double, double>> pairs;
+        std::set<double> thresholds;
+        while (thresholds.size() < brackets) {
+            thresholds.insert(double(gen() % 1000000));
+        }
+        for (double threshold : thresholds) {
+            pairs.push_back({ threshold, double(gen() % 10000) });
+        }
+        std::shuffle(pairs.begin(), pairs.end(), gen);
+        BracketTable table(pairs);
+        std::vector<double> amounts;
+        for (double threshold : thresholds) {
+            amounts.push_back(threshold);
+            amounts.push_back(std::nextafter(threshold, -1.0));
+        }
+        for (int i = 0; i < 100; ++i) {
+            amounts.push_back(double(gen() % 1100000));
+        }
+        for (double amount : amounts) {
+            if (table.bonus(amount) != table.bonusByIfChain(amount)) {
+                return std::to_string(brackets) + " brackets: the bonus for " + std::to_string(amount) + " differs from the if chain";
+            }
         }
-        return total;
     }
+    return "";
+}
 
-    void listDepositors() const {
-        if (depositors.empty()) {
-            std::cout << "No depositors were added.\n";
-            return;
+// Self-test: timestamp parsing and month numbering against the C library's gmtime
+std::string checkCalendar(unsigned long long seed) {
+    std::mt19937_64 gen(seed);
+    for (int i = 0; i < 20000; ++i) {
+        // 1900-01-01 to 2199-12-31, so leap centuries on both sides are covered
+        long long seconds = -2208988800LL + static_cast<long long>(gen() % 9467107200ULL);
+        std::time_t t = static_cast<std::time_t>(seconds);
+        std::tm parts = *std::gmtime(&t);
+        char text[32];
+        std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &parts);
+        if (parseTimestamp(text) != seconds * 1000000000LL) {
+            return std::string("parseTimestamp(") + text + ") is wrong";
         }
+        long long day = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+        if (monthOfDay(day) != (parts.tm_year - 70) * 12 + parts.tm_mon) {
+            return std::string("monthOfDay is wrong for ") + text;
+        }
+    }
+    return "";
+}
 
-        std::cout << "\nList of depositors:\n";
-        for (const auto& depositor : depositors) {
-            std::cout << "Depositor ID: " << depositor.getID()
-                << ", Name: " << depositor.getName()
-                << ", Deposit Amount: " << depositor.getDepositAmount() << std::endl;
+// Self-test mode: checks the transaction history and the indexes against straightforward reference
+// implementations on seeded random data. Prints one PASS or FAIL line per check and exits with 1 if
+// any check fails.
+// Usage: lab3 --self-test [--seed n]
+int runSelfTest(const std::vector<std::string>& args) {
+    unsigned long long seed = 1;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--seed" && i + 1 < args.size() && isNumeric(args[i + 1])) {
+            seed = static_cast<unsigned long long>(std::stod(args[++i]));
         }
     }
-};
+    int failures = 0;
+    auto report = [&](const std::string& name, const std::string& failure) {
+        if (failure.empty()) {
+            std::cout << "PASS " << name << "\n";
+        }
+        else {
+            std::cout << "FAIL " << name << ": " << failure << "\n";
+            ++failures;
+        }
+    };
+    report("transaction history (global lock)", checkTransactionHistory(ConcurrencyMode::GlobalLock, seed));
+    report("transaction history (sharded)", checkTransactionHistory(ConcurrencyMode::Sharded, seed));
+    report("transaction history (lock-free)", checkTransactionHistory(ConcurrencyMode::LockFree, seed));
+    report("deposit batches (global lock)", checkDepositMany(ConcurrencyMode::GlobalLock, seed));
+    report("deposit batches (sharded)", checkDepositMany(ConcurrencyMode::Sharded, seed));
+    report("deposit batches (lock-free)", checkDepositMany(ConcurrencyMode::LockFree, seed));
+    report("balance index", checkBalanceIndex(seed));
+    report("balance distribution", checkBalanceDistribution(seed));
+    report("roaring bitmap", checkRoaringBitmap(seed));
+    report("name index", checkNameIndex(seed));
+    report("bracket table", checkBracketTable(seed));
+    report("calendar", checkCalendar(seed));
+    std::cout << (failures ? std::to_string(failures) + " checks failed\n" : std::string("All checks passed\n"));
+    return failures ? 1 : 0;
+}
 
 // Helper function to get valid depositor name
 std::string getValidDepositorName() {
@@ -184,12 +6207,12 @@ std::string getValidDepositorName() {
     return name;
 }
 
-// Helper function to get valid deposit amount
-double getValidDepositAmount() {
+// Helper function to get valid deposit amount, asking with the given prompt
+double getValidDepositAmount(const std::string& prompt = "Enter deposit amount: ") {
     std::string amountStr;
     double amount;
     while (true) {
-        std::cout << "Enter deposit amount: ";
+        std::cout << prompt;
         std::cin >> amountStr;
         if (isNumeric(amountStr)) {
             amount = std::stod(amountStr);
@@ -208,10 +6231,112 @@ double getValidDepositAmount() {
 }
 
 // Main function to interact with the user
-int main() {
-    Bank bank;
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args;
+#ifdef BANK_TRACE
+    TraceCollector::instance();
+    std::atexit(writeTraceAtExit);
+#endif
+    bool dumpStatsAtExit = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--stats") {
+            // Global flag: record per-operation latency, available via the stats command and dumped at exit
+            LatencyRecorder::instance().enable();
+            dumpStatsAtExit = true;
+        }
+        else if (std::string(argv[i]) == "--metrics-port" && i + 1 < argc && isNumeric(argv[i + 1])) {
+            // Global flag: serve live metrics in Prometheus text format on 127.0.0.1:<port>
+            metricsPort = std::atoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--deterministic") {
+            // Global flag: simulated clock and seeded IDs so runs can be replayed exactly
+            deterministicRun = true;
+            if (i + 1 < argc && isNumeric(argv[i + 1])) {
+                deterministicSeed = std::strtoull(argv[++i], nullptr, 10);
+            }
+        }
+        else if (std::string(argv[i]) == "--strategies" && i + 1 < argc) {
+            // Global flag: file of rule strategies offered next to Normal and Fixed
+            try {
+                loadRuleStrategies(argv[++i]);
+            }
+            catch (const InvalidInputException& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]) == "--alloc-track") {
+            // Global flag: attribute allocations to Bank operations, reported like --stats
+            allocationTrackingEnabled.store(true, std::memory_order_relaxed);
+            dumpStatsAtExit = true;
+        }
+        else if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+            // Global flag: file that receives the Chrome trace (only in builds with -DBANK_TRACE)
+#ifdef BANK_TRACE
+            TraceCollector::instance().setOutputPath(argv[++i]);
+#else
+            ++i;
+            std::cerr << "Warning: tracing is not compiled in (rebuild with -DBANK_TRACE); --trace ignored.\n";
+#endif
+        }
+        else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (dumpStatsAtExit) {
+        std::atexit(dumpOperationStats);
+    }
+    if (!args.empty() && args[0].compare(0, 2, "--") == 0) {
+        std::vector<std::string> options(args.begin() + 1, args.end());
+        try {
+            if (args[0] == "--bench") {
+                return runBenchmarks(options);
+            }
+            if (args[0] == "--workload") {
+                return runWorkload(options);
+            }
+            if (args[0] == "--scaling") {
+                return runScaling(options);
+            }
+            if (args[0] == "--transfers") {
+                return runTransferBenchmark(options);
+            }
+            if (args[0] == "--footprint") {
+                return runFootprint(options);
+            }
+            if (args[0] == "--interest") {
+                return runInterestBenchmark(options);
+            }
+            if (args[0] == "--reload") {
+                return runReloadBenchmark(options);
+            }
+            if (args[0] == "--self-test") {
+                return runSelfTest(options);
+            }
+            if (args[0] == "--batch") {
+                Bank bank(std::cout, std::cerr, makeBankOptions());
+                auto metricsServer = startMetricsServer(bank);
+                if (options.empty() || options[0] == "-") {
+                    return runBatch(std::cin, bank);
+                }
+                std::ifstream file(options[0]);
+                if (!file) {
+                    throw InvalidInputException("Cannot open batch file: " + options[0]);
+                }
+                return runBatch(file, bank);
+            }
+            throw InvalidInputException("Unknown mode: " + args[0]);
+        }
+        catch (const InvalidInputException& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    Bank bank(std::cout, std::cerr, makeBankOptions());
     std::string choice;
     try {
+        auto metricsServer = startMetricsServer(bank);
         while (true) {
             std::cout << "\nSelect an option:\n";
             std::cout << "1. Add Depositor\n";
@@ -219,6 +6344,22 @@ int main() {
             std::cout << "3. View Total Deposits\n";
             std::cout << "4. Deposit Amount\n"; // The only way to deposit
             std::cout << "5. Exit\n";
+            std::cout << "6. Show Operation Stats\n";
+            std::cout << "7. Withdraw Amount\n";
+            std::cout << "8. Transfer Amount\n";
+            std::cout << "9. Show Recent Transactions\n";
+            std::cout << "10. Show Balance At Time\n";
+            std::cout << "11. Show Top Depositors\n";
+            std::cout << "12. Show Depositors In Balance Range\n";
+            std::cout << "13. Show Total Held By Bottom Percent\n";
+            std::cout << "14. Show Percentile Rank\n";
+            std::cout << "15. Show Strategy Report\n";
+            std::cout << "16. Tag Depositor\n";
+            std::cout << "17. Filter Depositors\n";
+            std::cout << "18. Search Depositors By Name\n";
+            std::cout << "19. Find Similar Names\n";
+            std::cout << "20. Apply Interest\n";
+            std::cout << "21. Configure Strategy\n";
             std::cout << "Enter your choice: ";
             std::cin >> choice;
 
@@ -227,7 +6368,11 @@ int main() {
                 int strategyChoice;
                 const IDeposit* strategy = nullptr;
                 while (true) {
-                    std::cout << "Choose deposit strategy (1: Normal, 2: Fixed): ";
+                    std::cout << "Choose deposit strategy (1: Normal, 2: Fixed, 3: Tiered";
+                    for (size_t i = 0; i < ruleStrategies.size(); ++i) {
+                        std::cout << ", " << i + 4 << ": " << ruleStrategies[i]->label();
+                    }
+                    std::cout << "): ";
                     std::cin >> strategyChoice;
                     if (strategyChoice == 1) {
                         strategy = new NormalDeposit();
@@ -237,6 +6382,14 @@ int main() {
                         strategy = new FixedDeposit();
                         break;
                     }
+                    else if (strategyChoice == 3) {
+                        strategy = new TieredDeposit();
+                        break;
+                    }
+                    else if (strategyChoice >= 4 && static_cast<size_t>(strategyChoice - 4) < ruleStrategies.size()) {
+                        strategy = ruleStrategies[strategyChoice - 4].get();
+                        break;
+                    }
                     else {
                         std::cerr << "Invalid strategy choice. Please try again.\n";
                     }
@@ -246,15 +6399,27 @@ int main() {
 
             }
             else if (choice == "2") {
-                bank.listDepositors();
+                // A Fixed account's displayed amount is rejected once its balance exceeds the cap, which
+                // option 21 can lower
+                try {
+                    bank.listDepositors();
+                }
+                catch (const InvalidInputException& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
             }
             else if (choice == "3") {
-                double totalDeposits = bank.calculateTotalDeposits();
-                if (totalDeposits == 0) {
-                    std::cout << "No deposits have been made yet.\n";
+                try {
+                    double totalDeposits = bank.calculateTotalDeposits();
+                    if (totalDeposits == 0) {
+                        std::cout << "No deposits have been made yet.\n";
+                    }
+                    else {
+                        std::cout << "Total deposits: " << totalDeposits << std::endl;
+                    }
                 }
-                else {
-                    std::cout << "Total deposits: " << totalDeposits << std::endl;
+                catch (const InvalidInputException& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
                 }
             }
             else if (choice == "4") {
@@ -273,6 +6438,228 @@ int main() {
                 std::cout << "Exiting program.\n";
                 break;
             }
+            else if (choice == "6") {
+                printOperationStats(std::cout);
+            }
+            else if (choice == "7") {
+                std::string depositorID;
+                std::cout << "Enter depositor ID to withdraw from: ";
+                std::cin >> depositorID;
+
+                double amount = getValidDepositAmount("Enter withdrawal amount: ");
+
+                if (!bank.withdrawFromAccount(depositorID, amount)) {
+                    std::cerr << "No depositor found with the ID: " << depositorID << "\n";
+                }
+            }
+            else if (choice == "8") {
+                std::string fromID, toID;
+                std::cout << "Enter depositor ID to transfer from: ";
+                std::cin >> fromID;
+                std::cout << "Enter depositor ID to transfer to: ";
+                std::cin >> toID;
+
+                double amount = getValidDepositAmount("Enter transfer amount: ");
+
+                if (!bank.transferBetweenAccounts(fromID, toID, amount)) {
+                    std::cerr << "No depositor found with the IDs: " << fromID << ", " << toID << "\n";
+                }
+            }
+            else if (choice == "9") {
+                std::string depositorID;
+                std::cout << "Enter depositor ID to show transactions for: ";
+                std::cin >> depositorID;
+
+                std::vector<Transaction> transactions;
+                if (bank.recentTransactions(depositorID, 10, transactions)) {
+                    printTransactions(transactions, std::cout);
+                }
+                else {
+                    std::cerr << "No depositor found with the ID: " << depositorID << "\n";
+                }
+            }
+            else if (choice == "10") {
+                std::string depositorID, timestamp;
+                std::cout << "Enter depositor ID: ";
+                std::cin >> depositorID;
+                std::cout << "Enter UTC time (YYYY-MM-DDTHH:MM:SS): ";
+                std::cin >> timestamp;
+
+                try {
+                    double balance;
+                    if (bank.balanceAt(depositorID, parseTimestamp(timestamp), balance)) {
+                        std::cout << "Balance at " << timestamp << ": " << balance << "\n";
+                    }
+                    else {
+                        std::cerr << "No depositor found with the ID: " << depositorID << "\n";
+                    }
+                }
+                catch (const InvalidInputException& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+            }
+            else if (choice == "11") {
+                std::string countStr;
+                std::cout << "Enter number of depositors to show: ";
+                std::cin >> countStr;
+                if (isNumeric(countStr) && std::stod(countStr) >= 0) {
+                    printRanking(bank.topK(static_cast<size_t>(std::stod(countStr))), std::cout);
+                }
+                else {
+                    std::cerr << "Invalid number.\n";
+                }
+            }
+            else if (choice == "12") {
+                std::string lowStr, highStr;
+                std::cout << "Enter lowest balance: ";
+                std::cin >> lowStr;
+                std::cout << "Enter highest balance: ";
+                std::cin >> highStr;
+                if (isNumeric(lowStr) && isNumeric(highStr)) {
+                    std::vector<RankedDepositor> matches = bank.depositorsInRange(std::stod(lowStr), std::stod(highStr));
+                    for (const auto& match : matches) {
+                        std::cout << "Depositor ID: " << match.id << ", Name: " << match.name
+                            << ", Balance: " << match.balance << "\n";
+                    }
+                    std::cout << matches.size() << " depositors in range.\n";
+                }
+                else {
+                    std::cerr << "Invalid amount. Please enter a numeric value.\n";
+                }
+            }
+            else if (choice == "13") {
+                std::string percentStr;
+                std::cout << "Enter percent of depositors (0-100): ";
+                std::cin >> percentStr;
+                if (isNumeric(percentStr)) {
+                    try {
+                        double held = bank.totalHeldByBottom(std::stod(percentStr));
+                        std::cout << "Bottom " << percentStr << "% of depositors hold about: " << held << "\n";
+                    }
+                    catch (const InvalidInputException& e) {
+                        std::cerr << "Error: " << e.what() << std::endl;
+                    }
+                }
+                else {
+                    std::cerr << "Invalid percent. Please enter a numeric value.\n";
+                }
+            }
+            else if (choice == "14") {
+                std::string depositorID;
+                std::cout << "Enter depositor ID: ";
+                std::cin >> depositorID;
+
+                double percentile;
+                if (bank.percentileRank(depositorID, percentile)) {
+                    std::cout << "Percentile rank: " << percentile << "\n";
+                }
+                else {
+                    std::cerr << "No depositor found with the ID: " << depositorID << "\n";
+                }
+            }
+            else if (choice == "15") {
+                printStrategySummaries(bank.strategySummaries(), std::cout);
+            }
+            else if (choice == "16") {
+                std::string depositorID, tag;
+                std::cout << "Enter depositor ID to tag: ";
+                std::cin >> depositorID;
+                std::cout << "Enter tag: ";
+                std::cin >> tag;
+
+                try {
+                    if (!bank.tagDepositor(depositorID, tag)) {
+                        std::cerr << "No depositor found with the ID: " << depositorID << "\n";
+                    }
+                }
+                catch (const InvalidInputException& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+            }
+            else if (choice == "17") {
+                std::string line;
+                std::cout << "Enter filter (e.g. Fixed AND tag=vip): ";
+                std::getline(std::cin >> std::ws, line);
+
+                std::stringstream ss(line);
+                std::vector<std::string> terms;
+                for (std::string term; ss >> term;) {
+                    terms.push_back(term);
+                }
+                try {
+                    FilterResult result = bank.filterDepositors(terms);
+                    std::cout << result.count << " depositors match, total balance: " << result.total << "\n";
+                }
+                catch (const InvalidInputException& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+            }
+            else if (choice == "18") {
+                std::string text, mode;
+                std::cout << "Enter name or part of a name: ";
+                std::cin >> text;
+                std::cout << "Match (1: Name starts with, 2: Name contains): ";
+                std::cin >> mode;
+
+                std::vector<RankedDepositor> matches = bank.searchNames(text, mode == "2", 20);
+                for (const auto& match : matches) {
+                    std::cout << "Depositor ID: " << match.id << ", Name: " << match.name
+                        << ", Balance: " << match.balance << "\n";
+                }
+                std::cout << matches.size() << " depositors found (at most 20 are shown).\n";
+            }
+            else if (choice == "19") {
+                std::string text;
+                std::cout << "Enter name: ";
+                std::cin >> text;
+
+                try {
+                    printNameMatches(bank.similarNames(text, 2, 10), std::cout);
+                }
+                catch (const InvalidInputException& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+            }
+            else if (choice == "20") {
+                std::string periodsStr, normalStr, fixedStr;
+                std::cout << "Enter number of periods: ";
+                std::cin >> periodsStr;
+                std::cout << "Enter interest per period for Normal deposits (%): ";
+                std::cin >> normalStr;
+                std::cout << "Enter interest per period for Fixed deposits (%): ";
+                std::cin >> fixedStr;
+
+                std::vector<std::pair<std::string, long long>> rates(2);
+                if (isNumeric(periodsStr) && std::stod(periodsStr) >= 0 && std::stod(periodsStr) <= Bank::kMaxInterestPeriods
+                    && parseInterestRate("Normal=" + normalStr, rates[0]) && parseInterestRate("Fixed=" + fixedStr, rates[1])) {
+                    try {
+                        AccrualResult result = bank.accrueInterest(rates, static_cast<unsigned>(std::stod(periodsStr)));
+                        std::cout << "Interest of " << result.credited << " paid to " << result.accounts << " accounts\n";
+                    }
+                    catch (const InvalidInputException& e) {
+                        std::cerr << "Error: " << e.what() << std::endl;
+                    }
+                }
+                else {
+                    std::cerr << "Invalid input. Periods must be between 0 and " << Bank::kMaxInterestPeriods
+                        << " and rates between -100 and 100.\n";
+                }
+            }
+            else if (choice == "21") {
+                std::string name, rules;
+                std::cout << "Enter strategy name: ";
+                std::cin >> name;
+                std::cout << "Enter new rules (e.g. cap=2000000 bonus=150): ";
+                std::getline(std::cin >> std::ws, rules);
+
+                try {
+                    configureStrategy(name, rules);
+                    std::cout << "Strategy " << name << " reconfigured\n";
+                }
+                catch (const InvalidInputException& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+            }
             else {
                 std::cerr << "Invalid choice. Please try again.\n";
             }